@@ -0,0 +1,393 @@
+#include <cmath>
+#include <thread>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// --analyze: steganalysis of a carrier, to check how detectable a message is before releasing it.
+//  - Chi-square attack (Westfeld and Pfitzmann): LSB replacement evens out the counts of the pairs of
+//    values 2i and 2i+1. The statistic compares the count of 2i with the mean of the pair; the probability
+//    of embedding is the chance of a chi-square value at least that large, near 1 when the pairs are even.
+//  - RS analysis (Fridrich, Goljan and Du): groups of 4 neighbouring samples of one channel become more
+//    or less smooth (Regular, Singular) when the LSBs of the middle two are flipped (mask M) or moved the
+//    other way (-M). Natural images have about as many R and S groups under M as under -M; embedding
+//    pulls R_M and S_M together and drives R_-M and S_-M apart. The same counts for the image with every
+//    LSB flipped give the estimated share of carrier bytes that hold a message.
+// Every byte of the pixel data is a sample (BMP, 8 bit PNG), groups are taken along rows, and the rows of a
+// band are shared by threads that each count on their own. The histogram uses 4 tables, one for every byte
+// of a 32 bit word, so consecutive equal bytes do not wait for each other's increments.
+
+// The counts of some rows; threads and bands are added up
+struct AnalysisCounts {
+    std::array<uint64_t, 256> histogram{};
+    uint64_t regular[2][2]{};  // [image with flipped LSBs][mask -M] groups that got less smooth
+    uint64_t singular[2][2]{}; // groups that got smoother
+    uint64_t groups = 0;
+    uint64_t samples = 0;
+
+    void add(const AnalysisCounts& other) {
+        for (size_t value = 0; value < 256; ++value) {
+            histogram[value] += other.histogram[value];
+        }
+        for (int flipped = 0; flipped < 2; ++flipped) {
+            for (int negative = 0; negative < 2; ++negative) {
+                regular[flipped][negative] += other.regular[flipped][negative];
+                singular[flipped][negative] += other.singular[flipped][negative];
+            }
+        }
+        groups += other.groups;
+        samples += other.samples;
+    }
+};
+
+// The statistics of a carrier
+struct AnalysisResult {
+    std::string filename;
+    uint64_t samples = 0;
+    double chiSquare = 0;
+    unsigned degreesOfFreedom = 0;
+    double chiSquareProbability = 0; // probability of embedding
+    double rs[4] = {};               // R_M, S_M, R_-M, S_-M as shares of the groups
+    double rsEstimate = 0;           // estimated share of the carrier bytes holding a message
+    std::string error;
+};
+
+// Function to get the smoothness of a group of 4 samples, the sum of the differences of neighbours
+inline int groupVariation(int a, int b, int c, int d) {
+    return std::abs(b - a) + std::abs(c - b) + std::abs(d - c);
+}
+
+// Function to count the RS groups of lanes groups of 4 samples x0[i], x1[i], x2[i], x3[i] into counts
+void countRSGroups(const int16_t* x0, const int16_t* x1, const int16_t* x2, const int16_t* x3, size_t lanes, AnalysisCounts& counts) {
+    size_t lane = 0;
+#if defined(__SSE2__)
+    auto difference = [](__m128i a, __m128i b) { return _mm_sub_epi16(_mm_max_epi16(a, b), _mm_min_epi16(a, b)); };
+    auto variation = [&](__m128i a, __m128i b, __m128i c, __m128i d) {
+        return _mm_add_epi16(_mm_add_epi16(difference(a, b), difference(b, c)), difference(c, d));
+    };
+    const __m128i one = _mm_set1_epi16(1);
+    while (lane + 8 <= lanes) {
+        // Every lane of the sums counts up to 32767 groups (subtracting the -1 of a true comparison)
+        __m128i sums[2][4];
+        for (auto& sum : sums) {
+            std::fill(std::begin(sum), std::end(sum), _mm_setzero_si128());
+        }
+        size_t end = std::min(lanes, lane + 8 * 32767) & ~size_t(7);
+        for (; lane < end; lane += 8) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x0 + lane));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x1 + lane));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x2 + lane));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x3 + lane));
+            for (int flipped = 0; flipped < 2; ++flipped) {
+                if (flipped) {
+                    a = _mm_xor_si128(a, one);
+                    b = _mm_xor_si128(b, one);
+                    c = _mm_xor_si128(c, one);
+                    d = _mm_xor_si128(d, one);
+                }
+                __m128i base = variation(a, b, c, d);
+                __m128i positive = variation(a, _mm_xor_si128(b, one), _mm_xor_si128(c, one), d);
+                // -M: even values go down, odd ones up: x - 1 + 2 (x & 1)
+                __m128i nb = _mm_sub_epi16(_mm_add_epi16(b, _mm_slli_epi16(_mm_and_si128(b, one), 1)), one);
+                __m128i nc = _mm_sub_epi16(_mm_add_epi16(c, _mm_slli_epi16(_mm_and_si128(c, one), 1)), one);
+                __m128i negative = variation(a, nb, nc, d);
+                sums[flipped][0] = _mm_sub_epi16(sums[flipped][0], _mm_cmpgt_epi16(positive, base));
+                sums[flipped][1] = _mm_sub_epi16(sums[flipped][1], _mm_cmplt_epi16(positive, base));
+                sums[flipped][2] = _mm_sub_epi16(sums[flipped][2], _mm_cmpgt_epi16(negative, base));
+                sums[flipped][3] = _mm_sub_epi16(sums[flipped][3], _mm_cmplt_epi16(negative, base));
+            }
+        }
+        for (int flipped = 0; flipped < 2; ++flipped) {
+            for (int k = 0; k < 4; ++k) {
+                alignas(16) uint16_t lanesSum[8];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanesSum), sums[flipped][k]);
+                uint64_t total = 0;
+                for (uint16_t value : lanesSum) {
+                    total += value;
+                }
+                (k % 2 == 0 ? counts.regular : counts.singular)[flipped][k / 2] += total;
+            }
+        }
+    }
+#endif
+    for (; lane < lanes; ++lane) {
+        for (int flipped = 0; flipped < 2; ++flipped) {
+            int a = x0[lane] ^ flipped, b = x1[lane] ^ flipped, c = x2[lane] ^ flipped, d = x3[lane] ^ flipped;
+            int base = groupVariation(a, b, c, d);
+            // M flips the LSB (0 <-> 1, 2 <-> 3), -M shifts the other way (-1 <-> 0, 1 <-> 2)
+            int positive = groupVariation(a, b ^ 1, c ^ 1, d);
+            int negative = groupVariation(a, b - 1 + 2 * (b & 1), c - 1 + 2 * (c & 1), d);
+            counts.regular[flipped][0] += positive > base;
+            counts.singular[flipped][0] += positive < base;
+            counts.regular[flipped][1] += negative > base;
+            counts.singular[flipped][1] += negative < base;
+        }
+    }
+    counts.groups += lanes;
+}
+
+// Function to count the samples of rows of rowBytes bytes, stride bytes apart, into counts
+void analyzeRows(const unsigned char* data, size_t rows, size_t stride, size_t rowBytes, unsigned channels, AnalysisCounts& counts) {
+    uint64_t tables[4][256] = {};
+    size_t groupBytes = 4 * channels;
+    std::vector<int16_t> planes[4];
+    for (std::vector<int16_t>& plane : planes) {
+        plane.resize(rowBytes / 4);
+    }
+    for (size_t row = 0; row < rows; ++row) {
+        const unsigned char* samples = data + row * stride;
+        size_t i = 0;
+        for (; i + 4 <= rowBytes; i += 4) {
+            ++tables[0][samples[i]];
+            ++tables[1][samples[i + 1]];
+            ++tables[2][samples[i + 2]];
+            ++tables[3][samples[i + 3]];
+        }
+        for (; i < rowBytes; ++i) {
+            ++tables[0][samples[i]];
+        }
+
+        // The samples of every group and channel, planar, so groups can be compared 8 at a time
+        size_t lanes = 0;
+        for (size_t group = 0; group + groupBytes <= rowBytes; group += groupBytes) {
+            for (unsigned channel = 0; channel < channels; ++channel, ++lanes) {
+                for (unsigned j = 0; j < 4; ++j) {
+                    planes[j][lanes] = samples[group + j * channels + channel];
+                }
+            }
+        }
+        countRSGroups(planes[0].data(), planes[1].data(), planes[2].data(), planes[3].data(), lanes, counts);
+        counts.samples += rowBytes;
+    }
+    for (size_t value = 0; value < 256; ++value) {
+        counts.histogram[value] += tables[0][value] + tables[1][value] + tables[2][value] + tables[3][value];
+    }
+}
+
+// Function to count a band of rows; large bands are split among threads by rows
+void analyzeBand(const char* data, size_t rows, size_t stride, size_t rowBytes, unsigned channels, AnalysisCounts& counts) {
+    STATS_TIMER(Analyze);
+    const unsigned char* samples = reinterpret_cast<const unsigned char*>(data);
+    size_t threadCount = rows * stride < parallelBandSize ? 1 : std::min<size_t>(rows, std::max(1u, std::thread::hardware_concurrency()));
+    if (threadCount <= 1) {
+        analyzeRows(samples, rows, stride, rowBytes, channels, counts);
+        return;
+    }
+    std::vector<AnalysisCounts> parts(threadCount);
+    {
+        std::vector<std::jthread> threads;
+        for (size_t i = 0; i < threadCount; ++i) {
+            size_t first = rows * i / threadCount, last = rows * (i + 1) / threadCount;
+            threads.emplace_back([&, i, first, last]() {
+                analyzeRows(samples + first * stride, last - first, stride, rowBytes, channels, parts[i]);
+            });
+        }
+    }
+    for (const AnalysisCounts& part : parts) {
+        counts.add(part);
+    }
+}
+
+// Function to get the regularized upper incomplete gamma function Q(a, x), the chance that a chi-square
+// variable with 2a degrees of freedom exceeds 2x (series below a + 1, continued fraction above)
+double upperGammaRatio(double a, double x) {
+    if (x <= 0) {
+        return 1;
+    }
+    double prefix = std::exp(a * std::log(x) - x - std::lgamma(a));
+    if (x < a + 1) {
+        double term = 1 / a, sum = term;
+        for (int n = 1; n < 10000 && term > sum * 1e-15; ++n) {
+            term *= x / (a + n);
+            sum += term;
+        }
+        return std::max(0.0, 1 - sum * prefix);
+    }
+    const double tiny = 1e-300;
+    double b = x + 1 - a, c = 1 / tiny, d = 1 / b, fraction = d;
+    for (int n = 1; n < 10000; ++n) {
+        double an = -n * (n - a);
+        b += 2;
+        d = an * d + b;
+        d = std::fabs(d) < tiny ? tiny : d;
+        c = b + an / c;
+        c = std::fabs(c) < tiny ? tiny : c;
+        d = 1 / d;
+        fraction *= d * c;
+        if (std::fabs(d * c - 1) < 1e-15) {
+            break;
+        }
+    }
+    return prefix * fraction;
+}
+
+// Function to turn the counts into the statistics
+void computeAnalysis(const AnalysisCounts& counts, AnalysisResult& result) {
+    const uint64_t minPairSamples = 10; // pairs seen less often say nothing
+    unsigned pairs = 0;
+    for (size_t value = 0; value < 256; value += 2) {
+        uint64_t pair = counts.histogram[value] + counts.histogram[value + 1];
+        if (pair < minPairSamples) {
+            continue;
+        }
+        double expected = pair / 2.0;
+        double difference = counts.histogram[value] - expected;
+        result.chiSquare += difference * difference / expected;
+        ++pairs;
+    }
+    result.samples = counts.samples;
+    result.degreesOfFreedom = pairs > 0 ? pairs - 1 : 0;
+    result.chiSquareProbability = result.degreesOfFreedom > 0 ? upperGammaRatio(result.degreesOfFreedom / 2.0, result.chiSquare / 2) : 0;
+
+    if (counts.groups == 0) {
+        return;
+    }
+    double groups = static_cast<double>(counts.groups);
+    double d0 = (static_cast<double>(counts.regular[0][0]) - counts.singular[0][0]) / groups;  // R_M - S_M
+    double d1 = (static_cast<double>(counts.regular[1][0]) - counts.singular[1][0]) / groups;  // the same, LSBs flipped
+    double n0 = (static_cast<double>(counts.regular[0][1]) - counts.singular[0][1]) / groups;  // R_-M - S_-M
+    double n1 = (static_cast<double>(counts.regular[1][1]) - counts.singular[1][1]) / groups;
+    result.rs[0] = counts.regular[0][0] / groups;
+    result.rs[1] = counts.singular[0][0] / groups;
+    result.rs[2] = counts.regular[0][1] / groups;
+    result.rs[3] = counts.singular[0][1] / groups;
+    // The root x of 2 (d1 + d0) x^2 + (n0 - n1 - d1 - 3 d0) x + d0 - n0 nearest to 0 gives p = x / (x - 1/2)
+    double a = 2 * (d1 + d0), b = n0 - n1 - d1 - 3 * d0, c = d0 - n0;
+    double x;
+    if (std::fabs(a) < 1e-12) {
+        x = std::fabs(b) < 1e-12 ? 0 : -c / b;
+    } else {
+        double discriminant = std::max(0.0, b * b - 4 * a * c);
+        double root1 = (-b + std::sqrt(discriminant)) / (2 * a), root2 = (-b - std::sqrt(discriminant)) / (2 * a);
+        x = std::fabs(root1) < std::fabs(root2) ? root1 : root2;
+    }
+    result.rsEstimate = std::clamp(x / (x - 0.5), 0.0, 1.0);
+}
+
+// Function to count the pixel data of a BMP file band by band
+void analyzeBMP(const std::string& filename, AnalysisCounts& counts) {
+    FileDescriptor fd(openFile(filename, O_RDONLY));
+    if (fd.fd < 0) {
+        throw std::runtime_error("Could not open BMP file.");
+    }
+    char header[bmpHeaderSize];
+    readAt(fd.fd, header, bmpHeaderSize, 0);
+    uint32_t width, height;
+    uint16_t bitsPerPixel;
+    uint32_t dataOffset;
+    {
+        STATS_TIMER(HeaderParse);
+        dataOffset = parseBMPHeader(header, width, height, bitsPerPixel);
+    }
+    size_t stride = bmpRowStride(width, bitsPerPixel);
+    size_t bandRows = bmpBandSize(width, bitsPerPixel) / stride;
+    PooledBuffer band = BufferPool::local().acquire(std::min<size_t>(bandRows, height) * stride);
+    for (size_t row = 0; row < height; row += bandRows) {
+        size_t rows = std::min<size_t>(bandRows, height - row);
+        readAt(fd.fd, band.data(), rows * stride, dataOffset + row * stride);
+        analyzeBand(band.data(), rows, stride, static_cast<size_t>(width) * (bitsPerPixel / 8), bitsPerPixel / 8, counts);
+    }
+}
+
+// Function to count the samples of a PNG file; the decoded rows are collected into bands.
+// The scanlines of interlaced images are those of the Adam7 passes.
+void analyzePNG(const std::string& filename, AnalysisCounts& counts) {
+    std::ifstream file;
+    {
+        STATS_TIMER(Open);
+        file.open(filename, std::ios::binary);
+    }
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open PNG file.");
+    }
+    PNGInfo info;
+    readPNGHeader(file, info);
+    if (info.bitDepth != 8 || info.colorType == 3) {
+        throw std::runtime_error("Only PNG files with 8 bit samples can be analysed.");
+    }
+    size_t bandRows = std::max<size_t>(1, options.memoryBudget / info.stride);
+    PooledBuffer band = BufferPool::local().acquire(std::min<size_t>(bandRows, info.height) * info.stride);
+    size_t rows = 0, rowBytes = 0;
+    streamPNGRows(file, info, [&](const char* row, size_t length) {
+        if (rows == bandRows || (rows > 0 && length != rowBytes)) { // full, or the next Adam7 pass
+            analyzeBand(band.data(), rows, rowBytes, rowBytes, info.channels, counts);
+            rows = 0;
+        }
+        rowBytes = length;
+        std::memcpy(band.data() + rows++ * rowBytes, row, length);
+        return true;
+    });
+    if (rows > 0) {
+        analyzeBand(band.data(), rows, rowBytes, rowBytes, info.channels, counts);
+    }
+}
+
+// Function to analyse one carrier; errors are kept in the result
+AnalysisResult analyzeFile(const std::string& filename) {
+    TRACE_FILE(filename);
+    AnalysisResult result;
+    result.filename = filename;
+    try {
+        AnalysisCounts counts;
+        std::string extension = fileExtensionOf(filename);
+        if (extension == "bmp") {
+            analyzeBMP(filename, counts);
+        } else if (extension == "png") {
+            analyzePNG(filename, counts);
+        } else {
+            throw std::runtime_error("Unsupported file format. Only .bmp and .png are supported.");
+        }
+        computeAnalysis(counts, result);
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    return result;
+}
+
+// Function to print the statistics of a carrier as text, a JSON object or a CSV row (--format)
+void printAnalysis(const AnalysisResult& result) {
+    if (!result.error.empty()) {
+        std::cerr << result.filename << ": Error: " << result.error << std::endl;
+        return;
+    }
+    fmt::memory_buffer buffer;
+    if (options.format == "json") {
+        fmt::format_to(std::back_inserter(buffer), "{{\"file\":");
+        appendJSONString(buffer, result.filename);
+        fmt::format_to(std::back_inserter(buffer),
+                       ",\"samples\":{},\"chi_square\":{:.4f},\"degrees_of_freedom\":{},\"chi_square_probability\":{:.4f},"
+                       "\"rs_regular\":{:.4f},\"rs_singular\":{:.4f},\"rs_regular_negative\":{:.4f},"
+                       "\"rs_singular_negative\":{:.4f},\"rs_estimate\":{:.4f}}}",
+                       result.samples, result.chiSquare, result.degreesOfFreedom, result.chiSquareProbability,
+                       result.rs[0], result.rs[1], result.rs[2], result.rs[3], result.rsEstimate);
+    } else if (options.format == "csv") {
+        appendCSVField(buffer, result.filename);
+        fmt::format_to(std::back_inserter(buffer), ",{},{:.4f},{},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f}",
+                       result.samples, result.chiSquare, result.degreesOfFreedom, result.chiSquareProbability,
+                       result.rs[0], result.rs[1], result.rs[2], result.rs[3], result.rsEstimate);
+    } else {
+        fmt::format_to(std::back_inserter(buffer),
+                       "{}: {} samples\n"
+                       "  Chi-square: {:.2f} with {} degrees of freedom, probability of embedding {:.4f}\n"
+                       "  RS groups: R_M {:.4f}, S_M {:.4f}, R_-M {:.4f}, S_-M {:.4f}\n"
+                       "  RS estimated message length: {:.4f} of the carrier bytes",
+                       result.filename, result.samples, result.chiSquare, result.degreesOfFreedom, result.chiSquareProbability,
+                       result.rs[0], result.rs[1], result.rs[2], result.rs[3], result.rsEstimate);
+    }
+    std::cout << std::string_view(buffer.data(), buffer.size()) << std::endl;
+}
+
+// Function to analyse every file and print the results in order; returns false if any file failed
+bool runAnalysis(const std::vector<std::string>& filenames) {
+    if (options.format == "csv") {
+        std::cout << "file,samples,chi_square,degrees_of_freedom,chi_square_probability,rs_regular,rs_singular,"
+                     "rs_regular_negative,rs_singular_negative,rs_estimate" << std::endl;
+    }
+    bool allSucceeded = true;
+    for (const std::string& filename : filenames) {
+        AnalysisResult result = analyzeFile(filename);
+        printAnalysis(result);
+        allSucceeded = allSucceeded && result.error.empty();
+    }
+    return allSucceeded;
+}
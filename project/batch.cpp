@@ -0,0 +1,175 @@
+// Batch runs: one message embedded into, or extracted from, many carriers.
+// Every BMP file is handled by an IOTask (see ioTask.cpp) that opens it, reads its header and then
+// reads, embeds and writes back one band after the other. Up to options.queueDepth of these tasks are
+// in flight on one thread, and whichever request completes first lets its task continue, so the time
+// files wait for storage overlaps with the embedding and extraction of the others.
+// PNG files need the whole zlib stream and are processed synchronously when their turn comes, as are BMP
+// files with a coded --embedding mode (hamming<k> or stc<h>).
+
+// Result of one carrier in a batch run
+struct BatchFile {
+    std::string filename;
+    std::string message; // the extracted message
+    size_t modifiedBytes = 0; // carrier bytes changed by embedding
+    std::string error;
+    int traceId = -1;    // file id of the spans for --trace
+};
+
+// Function to get the lower case extension of a file name
+std::string fileExtensionOf(const std::string& filename) {
+    std::string extension = filename.substr(filename.find_last_of('.') + 1);
+    std::ranges::transform(extension, extension.begin(), ::tolower); //to lower case
+    return extension;
+}
+
+// Function to get the number of bytes of a completed request, throwing if it failed or came up short
+size_t checkIOResult(ssize_t result, size_t expected, const char* error) {
+    if (result < 0) {
+        throw std::runtime_error(strerror(-result));
+    }
+    if (static_cast<size_t>(result) != expected) {
+        throw std::runtime_error(error);
+    }
+    return expected;
+}
+
+// Task to embed message into (message != nullptr) or extract a message from one BMP file
+IOTask processBatchBMP(IOLoop& loop, BatchFile& file, const std::string* message) {
+    int fd = -1;
+    try {
+        ssize_t opened = co_await loop.open(file.filename, message ? O_RDWR : O_RDONLY);
+        if (opened < 0) {
+            throw std::runtime_error(strerror(-opened));
+        }
+        fd = static_cast<int>(opened);
+        char header[bmpHeaderSize];
+        checkIOResult(co_await loop.read(fd, header, bmpHeaderSize, 0), bmpHeaderSize, "Not a valid BMP file.");
+
+        uint32_t dataOffset;
+        size_t pixelBytes, bandSize;
+        {
+            STATS_TIMER(HeaderParse);
+            uint32_t width, height;
+            uint16_t bitsPerPixel;
+            dataOffset = parseBMPHeader(header, width, height, bitsPerPixel);
+            struct stat fileInfo{};
+            STATS_ADD(Syscalls, 1);
+            if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size <= dataOffset) {
+                throw std::runtime_error("Could not get file size.");
+            }
+            pixelBytes = fileInfo.st_size - dataOffset;
+            if (message && payloadLength(message->length()) > pixelBytes / (bitsPerPixel / 8) / 8) {
+                throw std::runtime_error("Message is too long to fit in the image.");
+            }
+            // Every file in flight gets its share of the memory budget, at least one row
+            size_t stride = bmpRowStride(width, bitsPerPixel);
+            size_t rows = std::max<size_t>(1, options.memoryBudget / options.queueDepth / stride);
+            bandSize = std::min(rows * stride, pixelBytes);
+        }
+        PooledBuffer band = BufferPool::local().acquire(bandSize);
+
+        if (message) {
+            BitReader bitsToEmbed(*message);
+            DirtyRanges dirty;
+            for (size_t bandStart = 0; bandStart < pixelBytes && !bitsToEmbed.done(); bandStart += bandSize) {
+                size_t length = std::min({bandSize, pixelBytes - bandStart, bitsToEmbed.remaining()});
+                checkIOResult(co_await loop.read(fd, band.data(), length, dataOffset + bandStart), length, "Could not read image data.");
+                dirty.clear();
+                embedBandBits(band.data(), length, bitsToEmbed, dataOffset + bandStart, dirty);
+                for (const auto& [start, end] : dirty.ranges) {
+                    checkIOResult(co_await loop.write(fd, band.data() + start, end - start, dataOffset + bandStart + start),
+                                  end - start, "Could not write image data.");
+                }
+            }
+            file.modifiedBytes = dirty.modifiedBytes;
+            if (dirty.modifiedBytes > 0) {
+                syncFile(fd);
+            }
+        } else {
+            BitWriter extracted(file.message);
+            for (size_t bandStart = 0; bandStart < pixelBytes; bandStart += bandSize) {
+                size_t length = std::min(bandSize, pixelBytes - bandStart);
+                checkIOResult(co_await loop.read(fd, band.data(), length, dataOffset + bandStart), length, "Could not read image data.");
+                if (collectBandBits(band.data(), length, extracted)) {
+                    break;
+                }
+            }
+            extracted.finish();
+        }
+    } catch (const std::exception& e) {
+        file.error = e.what();
+    }
+    if (fd >= 0) {
+        STATS_ADD(Syscalls, 1);
+        close(fd);
+    }
+}
+
+// Function to print the result of every file of a batch run in order; returns false if any file failed
+bool printBatchResults(const std::vector<BatchFile>& files, const std::string* message) {
+    bool allSucceeded = true;
+    for (const BatchFile& file : files) {
+        if (!file.error.empty()) {
+            std::cerr << file.filename << ": Error: " << file.error << std::endl;
+            allSucceeded = false;
+        } else if (message) {
+            std::cout << "Message successfully written to " << file.filename << " (" << file.modifiedBytes << " bytes modified)" << std::endl;
+        } else {
+            std::cout << file.filename << ": Decrypted message: " << file.message << std::endl;
+        }
+    }
+    return allSucceeded;
+}
+
+// Function to embed message into (message != nullptr) or extract a message from every file.
+// Results are printed in the order of filenames. Returns false if any file failed.
+bool runBatch(const std::vector<std::string>& filenames, const std::string* message) {
+    IOLoop loop(options.queueDepth);
+    std::vector<BatchFile> files(filenames.size());
+    size_t nextFile = 0;
+    size_t active = 0;
+
+    // Function to start files until options.queueDepth of them are in flight
+    auto fillQueue = [&]() {
+        while (nextFile < files.size() && active < options.queueDepth) {
+            BatchFile& file = files[nextFile++];
+            file.filename = filenames[nextFile - 1];
+            if (options.trace) {
+                file.traceId = tracer.fileId(file.filename);
+            }
+            TRACE_FILE_ID(file.traceId);
+            std::string extension = fileExtensionOf(file.filename);
+            if (extension == "png" || (extension == "bmp" && codedEmbedding())) {
+                try {
+                    if (message) {
+                        file.modifiedBytes = extension == "png" ? writeMessageToPNG(file.filename, *message)
+                                                                : writeMessageToBMP(file.filename, *message);
+                    } else {
+                        file.message = extension == "png" ? readMessageFromPNG(file.filename) : readMessageFromBMP(file.filename);
+                    }
+                } catch (const std::exception& e) {
+                    file.error = e.what();
+                }
+            } else if (extension != "bmp") {
+                file.error = "Unsupported file format. Only .bmp and .png are supported.";
+            } else {
+                IOTask task = processBatchBMP(loop, file, message);
+                if (!task.done()) {
+                    task.release(); // destroyed when runOne returns it finished
+                    ++active;
+                }
+            }
+        }
+    };
+
+    fillQueue();
+    while (std::coroutine_handle<> task = loop.runOne()) {
+        if (task.done()) {
+            task.destroy();
+            --active;
+            fillQueue();
+        }
+    }
+
+    return printBatchResults(files, message);
+}
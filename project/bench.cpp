@@ -0,0 +1,634 @@
+#include "steganography.cpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <new>
+#include <random>
+#include <sys/wait.h> // waitpid
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc
+#endif
+
+// Benchmarks for the steganography engine.
+// Synthetic carriers of every kernel variant are generated into a tmpfs directory, then embed, extract,
+// capacity check and info are timed on each of them. Every measurement is printed as one JSON object per
+// line (or one CSV row with --format csv), so results can be collected and compared between builds.
+//
+// Usage: bench [--dir <directory>] [--sizes 64K,1M,16M,256M] [--kernels bmp24,png-rgba8,...]
+//              [--repeat <count>] [--format json|csv] [--memory-budget <size>] [--io auto|uring|pread]
+//              [--embedding lsb|hamming<k>|stc<h>] [--stc-width <w>] [--stc-heights 6,8,10,12] [--checksums]
+//              [--batch <count>] [--batch-command <steganography binary>] [--queue-depth <n>]
+// Sizes are sizes of the pixel data, anything from 64K up to 2G.
+// --stc-heights runs the BMP kernels once more with a syndrome-trellis code of every constraint height
+// given, as kernels bmp24-stc-h<h>; their payload_bits_per_s shows what a height costs. The Viterbi
+// search takes 2^h steps per carrier byte, so keep the sizes small for large heights.
+// --batch runs the batch benchmark instead: count bmp24 carriers of every size (256K when --sizes is not
+// given) get a short message each, then the messages are extracted file by file through the fstream path
+// (readMessageFromBMP) and with runBatch over --io pread and --io uring, as kernel batch-bmp24 and
+// operations extract-fstream, extract-pread and extract-uring. With --batch-command the binary is also run
+// once per file with -d and this run's --embedding, --stc-width and --checksums, as operation
+// extract-process, which adds what starting a process costs. Before every repetition the pages of the
+// carriers are dropped with posix_fadvise(POSIX_FADV_DONTNEED), so each run starts from a cold cache. tmpfs
+// ignores that, so point --dir at a disk backed directory for the cold figures.
+
+// Heap allocations made through operator new, counted for the allocations column
+std::atomic<size_t> heapAllocations{0};
+std::atomic<size_t> heapAllocatedBytes{0};
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    heapAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+// Not inlined, so the compiler does not pair the inlined malloc/free with new/delete expressions
+__attribute__((noinline)) void operator delete(void* memory) noexcept { std::free(memory); }
+__attribute__((noinline)) void operator delete[](void* memory) noexcept { std::free(memory); }
+__attribute__((noinline)) void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+__attribute__((noinline)) void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+
+// Function to read the CPU cycle counter; the time stamp counter on x86, where it counts reference cycles
+bool readCycleCounter(uint64_t& cycles) {
+#if defined(__x86_64__) || defined(__i386__)
+    cycles = __rdtsc();
+    return true;
+#else
+    cycles = 0;
+    return false;
+#endif
+}
+
+// A carrier layout with its own embed/extract kernel
+struct BenchKernel {
+    std::string name;
+    bool png;
+    uint16_t bitsPerPixel; // BMP: 24 or 32; PNG: bits of one pixel
+    uint8_t colorType;     // PNG only
+    uint8_t bitDepth;      // PNG only
+};
+
+const std::vector<BenchKernel> benchKernels = {
+    {"bmp24", false, 24, 0, 0},
+    {"bmp32", false, 32, 0, 0},
+    {"png-rgb8", true, 24, 2, 8},
+    {"png-rgba8", true, 32, 6, 8},
+    {"png-gray16", true, 16, 0, 16},
+    {"png-palette", true, 8, 3, 8},
+};
+
+struct BenchSettings {
+    std::string directory;
+    std::vector<size_t> sizes = {64 << 10, 1 << 20, 16 << 20, 256 << 20};
+    std::vector<std::string> kernels;
+    int repeat = 3;
+    bool csv = false;
+    std::vector<unsigned> stcHeights; // --stc-heights
+    size_t batchFiles = 0;            // --batch, no batch benchmark when 0
+    std::string batchCommand;         // --batch-command, no extract-process when empty
+};
+
+// One timed operation on one carrier
+struct BenchResult {
+    std::string kernel;
+    std::string operation;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    size_t carrierBytes = 0; // pixel data of the carrier
+    size_t payloadBytes = 0;
+    double bestSeconds = 0;
+    double meanSeconds = 0;
+    bool haveCycles = false;
+    double cyclesPerByte = 0;
+    size_t allocations = 0;     // operator new calls during the last repetition
+    size_t allocatedBytes = 0;  // bytes requested from operator new during the last repetition
+    size_t poolAllocations = 0; // buffers the BufferPool had to allocate during the last repetition
+};
+
+// Function to fill a buffer with pseudo random pixel data, so the carrier LSBs look like camera noise
+void fillNoise(char* data, size_t length, std::mt19937_64& random) {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t value = random();
+        std::memcpy(data + i, &value, 8);
+    }
+    for (uint64_t value = random(); i < length; ++i, value >>= 8) {
+        data[i] = static_cast<char>(value);
+    }
+}
+
+// Function to pick image dimensions for about pixelBytes bytes of pixel data: roughly square, width a multiple of 16
+void benchDimensions(size_t pixelBytes, uint16_t bitsPerPixel, uint32_t& width, uint32_t& height) {
+    size_t pixels = std::max<size_t>(256, pixelBytes * 8 / bitsPerPixel);
+    width = std::max<uint32_t>(16, static_cast<uint32_t>(std::sqrt(static_cast<double>(pixels))) / 16 * 16);
+    height = static_cast<uint32_t>(pixels / width);
+}
+
+// Function to write a BMP carrier; the pixel data is generated and written in bands
+void generateBMP(const std::string& filename, uint32_t width, uint32_t height, uint16_t bitsPerPixel, std::mt19937_64& random) {
+    size_t stride = bmpRowStride(width, bitsPerPixel);
+    size_t pixelBytes = stride * height;
+    const uint32_t dataOffset = 54;
+
+    char header[dataOffset] = {};
+    auto put32 = [&](size_t offset, uint32_t value) { std::memcpy(header + offset, &value, 4); };
+    auto put16 = [&](size_t offset, uint16_t value) { std::memcpy(header + offset, &value, 2); };
+    header[0] = 'B';
+    header[1] = 'M';
+    put32(2, static_cast<uint32_t>(std::min<size_t>(dataOffset + pixelBytes, UINT32_MAX))); // file size
+    put32(10, dataOffset);
+    put32(14, 40); // BITMAPINFOHEADER
+    put32(18, width);
+    put32(22, height);
+    put16(26, 1); // planes
+    put16(28, bitsPerPixel);
+    put32(34, static_cast<uint32_t>(std::min<size_t>(pixelBytes, UINT32_MAX)));
+
+    FileDescriptor fd(open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    if (fd.fd < 0) {
+        throw std::runtime_error("Could not create " + filename + ": " + strerror(errno));
+    }
+    writeAt(fd.fd, header, dataOffset, 0);
+    PooledBuffer band = BufferPool::local().acquire(std::min<size_t>(pixelBytes, 4 << 20));
+    for (size_t offset = 0; offset < pixelBytes; offset += band.size()) {
+        size_t length = std::min(band.size(), pixelBytes - offset);
+        fillNoise(band.data(), length, random);
+        writeAt(fd.fd, band.data(), length, dataOffset + offset);
+    }
+}
+
+// Function to write a PNG carrier; scanlines are generated and deflated one at a time
+void generatePNG(const std::string& filename, uint32_t width, uint32_t height, const BenchKernel& kernel, std::mt19937_64& random) {
+    std::ofstream outfile(filename, std::ios::binary | std::ios::trunc);
+    if (!outfile) {
+        throw std::runtime_error("Could not create " + filename);
+    }
+    outfile.write("\x89PNG\r\n\x1a\n", 8);
+
+    char ihdr[13];
+    uint32_t widthBigEndian = __builtin_bswap32(width);
+    uint32_t heightBigEndian = __builtin_bswap32(height);
+    std::memcpy(ihdr, &widthBigEndian, 4);
+    std::memcpy(ihdr + 4, &heightBigEndian, 4);
+    ihdr[8] = static_cast<char>(kernel.bitDepth);
+    ihdr[9] = static_cast<char>(kernel.colorType);
+    ihdr[10] = 0; // compression method
+    ihdr[11] = 0; // filter method
+    ihdr[12] = 0; // no interlace
+    writePNGChunk(outfile, "IHDR", ihdr, 13);
+    if (kernel.colorType == 3) {
+        char palette[256 * 3];
+        fillNoise(palette, sizeof(palette), random);
+        writePNGChunk(outfile, "PLTE", palette, sizeof(palette));
+    }
+
+    // Filter type 0 on every scanline; noise does not compress anyway, so the fastest level is used
+    size_t stride = static_cast<size_t>(width) * kernel.bitsPerPixel / 8;
+    std::vector<char> scanline(stride + 1);
+    std::vector<char> idat(1 << 20);
+    z_stream stream{};
+    if (deflateInit(&stream, Z_BEST_SPEED) != Z_OK) {
+        throw std::runtime_error("Could not initialise zlib.");
+    }
+    auto deflateScanline = [&](int flush) {
+        int status;
+        do {
+            if (stream.avail_out == 0) {
+                writePNGChunk(outfile, "IDAT", idat.data(), idat.size());
+                stream.next_out = reinterpret_cast<Bytef*>(idat.data());
+                stream.avail_out = idat.size();
+            }
+            status = deflate(&stream, flush);
+        } while (stream.avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+    };
+    stream.next_out = reinterpret_cast<Bytef*>(idat.data());
+    stream.avail_out = idat.size();
+    for (uint32_t row = 0; row < height; ++row) {
+        scanline[0] = 0;
+        fillNoise(scanline.data() + 1, stride, random);
+        stream.next_in = reinterpret_cast<Bytef*>(scanline.data());
+        stream.avail_in = scanline.size();
+        deflateScanline(row + 1 == height ? Z_FINISH : Z_NO_FLUSH);
+    }
+    writePNGChunk(outfile, "IDAT", idat.data(), idat.size() - stream.avail_out);
+    deflateEnd(&stream);
+    writePNGChunk(outfile, "IEND", nullptr, 0);
+    if (!outfile) {
+        throw std::runtime_error("Could not write " + filename);
+    }
+}
+
+// Function to time an operation settings.repeat times, running prepare untimed before each repetition;
+// the engine's own console output is discarded meanwhile
+template<typename Prepare, typename Operation>
+void timeOperation(const BenchSettings& settings, BenchResult& result, Prepare&& prepare, Operation&& operation) {
+    std::streambuf* console = std::cout.rdbuf(nullptr);
+    double totalSeconds = 0;
+    result.bestSeconds = 0;
+    for (int i = 0; i < settings.repeat; ++i) {
+        try {
+            prepare();
+        } catch (...) {
+            std::cout.rdbuf(console);
+            std::cout.clear();
+            throw;
+        }
+        size_t allocationsBefore = heapAllocations.load();
+        size_t allocatedBytesBefore = heapAllocatedBytes.load();
+        size_t poolAllocationsBefore = BufferPool::local().allocations;
+        uint64_t cyclesBefore, cyclesAfter;
+        readCycleCounter(cyclesBefore);
+        auto startTime = std::chrono::steady_clock::now();
+        try {
+            operation();
+        } catch (...) {
+            std::cout.rdbuf(console);
+            std::cout.clear();
+            throw;
+        }
+        auto endTime = std::chrono::steady_clock::now();
+        result.haveCycles = readCycleCounter(cyclesAfter);
+        double seconds = std::chrono::duration<double>(endTime - startTime).count();
+        totalSeconds += seconds;
+        if (i == 0 || seconds < result.bestSeconds) {
+            result.bestSeconds = seconds;
+            result.cyclesPerByte = static_cast<double>(cyclesAfter - cyclesBefore) / result.carrierBytes;
+        }
+        result.allocations = heapAllocations.load() - allocationsBefore;
+        result.allocatedBytes = heapAllocatedBytes.load() - allocatedBytesBefore;
+        result.poolAllocations = BufferPool::local().allocations - poolAllocationsBefore;
+    }
+    result.meanSeconds = totalSeconds / settings.repeat;
+    std::cout.rdbuf(console);
+    std::cout.clear();
+}
+
+// Function to time an operation settings.repeat times
+template<typename Operation>
+void timeOperation(const BenchSettings& settings, BenchResult& result, Operation&& operation) {
+    timeOperation(settings, result, []() {}, std::forward<Operation>(operation));
+}
+
+// Function to print one result as a JSON object or a CSV row
+void printBenchResult(const BenchSettings& settings, const BenchResult& result) {
+    double megabytesPerSecond = result.carrierBytes / result.bestSeconds / 1e6;
+    double payloadBitsPerSecond = result.payloadBytes * 8 / result.bestSeconds;
+    std::ostringstream line;
+    line << std::fixed;
+    if (settings.csv) {
+        line << result.kernel << ',' << result.operation << ',' << result.width << ',' << result.height << ','
+             << result.carrierBytes << ',' << result.payloadBytes << ',' << std::setprecision(9) << result.bestSeconds << ','
+             << result.meanSeconds << ',' << std::setprecision(2) << megabytesPerSecond << ',';
+        if (result.haveCycles) {
+            line << std::setprecision(3) << result.cyclesPerByte;
+        }
+        line << ',' << result.allocations << ',' << result.allocatedBytes << ',' << result.poolAllocations << ','
+             << std::setprecision(0) << payloadBitsPerSecond;
+    } else {
+        line << "{\"kernel\":\"" << result.kernel << "\",\"operation\":\"" << result.operation
+             << "\",\"width\":" << result.width << ",\"height\":" << result.height
+             << ",\"carrier_bytes\":" << result.carrierBytes << ",\"payload_bytes\":" << result.payloadBytes
+             << ",\"best_seconds\":" << std::setprecision(9) << result.bestSeconds
+             << ",\"mean_seconds\":" << result.meanSeconds
+             << ",\"mb_per_s\":" << std::setprecision(2) << megabytesPerSecond << ",\"cycles_per_byte\":";
+        if (result.haveCycles) {
+            line << std::setprecision(3) << result.cyclesPerByte;
+        } else {
+            line << "null";
+        }
+        line << ",\"allocations\":" << result.allocations << ",\"allocated_bytes\":" << result.allocatedBytes
+             << ",\"pool_allocations\":" << result.poolAllocations
+             << ",\"payload_bits_per_s\":" << std::setprecision(0) << payloadBitsPerSecond << '}';
+    }
+    std::cout << line.str() << std::endl;
+}
+
+// Function to generate one carrier and run every operation on it
+void runBenchCase(const BenchSettings& settings, const BenchKernel& kernel, size_t size, std::mt19937_64& random) {
+    uint32_t width, height;
+    benchDimensions(size, kernel.bitsPerPixel, width, height);
+    std::string filename = settings.directory + "/stego-bench-" + std::to_string(getpid()) + "-" + kernel.name + "-"
+                           + std::to_string(size) + (kernel.png ? ".png" : ".bmp");
+    if (kernel.png) {
+        generatePNG(filename, width, height, kernel, random);
+    } else {
+        generateBMP(filename, width, height, kernel.bitsPerPixel, random);
+    }
+
+    // The payload fills the capacity of the carrier, one LSB per pixel, less the end of message marker;
+    // with --embedding hamming<k> or stc<h> at most what the code holds in the BMP carrier
+    size_t pixels = static_cast<size_t>(width) * height;
+    size_t payloadBytes = pixels / 8 - 2;
+    if (const HammingCode* code = selectedHammingCode(); code && !kernel.png) {
+        size_t groups = bmpRowStride(width, kernel.bitsPerPixel) * height / code->groupSize();
+        payloadBytes = std::min(payloadBytes, groups * code->bits() / 8 - 2);
+    }
+    if (const SyndromeTrellisCode* code = selectedTrellisCode(); code && !kernel.png) {
+        payloadBytes = std::min(payloadBytes, bmpRowStride(width, kernel.bitsPerPixel) * height / code->width() / 8 - 2);
+    }
+    payloadBytes -= payloadLength(payloadBytes) - payloadBytes; // room for the block checksums of --checksums
+    std::string message(payloadBytes, '\0');
+    for (char& character : message) {
+        character = static_cast<char>('a' + random() % 26);
+    }
+
+    BenchResult result;
+    result.kernel = kernel.name;
+    result.width = width;
+    result.height = height;
+    result.carrierBytes = kernel.png ? pixels * kernel.bitsPerPixel / 8 : bmpRowStride(width, kernel.bitsPerPixel) * height;
+    result.payloadBytes = message.length();
+
+    try {
+        result.operation = "embed";
+        timeOperation(settings, result, [&]() {
+            if (kernel.png) {
+                writeMessageToPNG(filename, message);
+            } else {
+                writeMessageToBMP(filename, message);
+            }
+        });
+        printBenchResult(settings, result);
+
+        result.operation = "extract";
+        std::string extracted;
+        timeOperation(settings, result, [&]() {
+            extracted = kernel.png ? readMessageFromPNG(filename) : readMessageFromBMP(filename);
+        });
+        if (extracted != message) {
+            throw std::runtime_error("The extracted message does not match the embedded one.");
+        }
+        printBenchResult(settings, result);
+
+        result.operation = "check";
+        timeOperation(settings, result, [&]() {
+            if (!canWriteMessage(filename, message)) {
+                throw std::runtime_error("The capacity check rejected a message that fits.");
+            }
+        });
+        printBenchResult(settings, result);
+
+        result.operation = "info";
+        result.payloadBytes = 0;
+        timeOperation(settings, result, [&]() {
+            printFileInfo(readFileInfo(filename));
+        });
+        printBenchResult(settings, result);
+    } catch (...) {
+        std::remove(filename.c_str());
+        throw;
+    }
+    std::remove(filename.c_str());
+}
+
+// Function to drop the cached pages of a file, writing back any that are dirty first
+void dropPageCache(const std::string& filename) {
+    FileDescriptor fd(open(filename.c_str(), O_RDONLY));
+    if (fd.fd < 0) {
+        throw std::runtime_error("Could not open " + filename + ": " + strerror(errno));
+    }
+    fdatasync(fd.fd);
+    if (int error = posix_fadvise(fd.fd, 0, 0, POSIX_FADV_DONTNEED); error != 0) {
+        throw std::runtime_error("Could not drop the cached pages of " + filename + ": " + strerror(error));
+    }
+}
+
+// Function to get the options that make a steganography process extract what this one embedded
+std::vector<std::string> extractionArguments() {
+    const EmbeddingOptions& embedding = options.embedding;
+    std::string mode = embedding.mode;
+    if (mode == "hamming") {
+        mode += std::to_string(embedding.hammingBits);
+    } else if (mode == "stc") {
+        mode += std::to_string(embedding.stcHeight);
+    }
+    std::vector<std::string> arguments = {"--embedding", mode, "--stc-width", std::to_string(embedding.stcWidth)};
+    if (embedding.checksums) {
+        arguments.push_back("--checksums");
+    }
+    return arguments;
+}
+
+// Function to run command -d filename with the embedding options of this run and its output discarded,
+// throwing unless it succeeds
+void runExtractProcess(const std::string& command, const std::string& filename) {
+    std::vector<std::string> arguments = extractionArguments();
+    arguments.insert(arguments.begin(), command);
+    arguments.insert(arguments.end(), {"-d", filename});
+    std::vector<char*> argv;
+    for (std::string& argument : arguments) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+    pid_t child = fork();
+    if (child < 0) {
+        throw std::runtime_error(std::string("Could not start a process: ") + strerror(errno));
+    }
+    if (child == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        execv(command.c_str(), argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error("Could not extract the message of " + filename + " with " + command);
+    }
+}
+
+// Function to generate settings.batchFiles carriers of size bytes with a message each and time extracting
+// the messages per file through fstream and as a batch run with each I/O backend, from a cold cache
+void runBatchBenchCase(const BenchSettings& settings, size_t size, std::mt19937_64& random) {
+    const BenchKernel& kernel = benchKernels[0]; // bmp24
+    uint32_t width, height;
+    benchDimensions(size, kernel.bitsPerPixel, width, height);
+    std::vector<std::string> filenames;
+    std::vector<std::string> messages;
+    auto removeFiles = [&]() {
+        for (const std::string& filename : filenames) {
+            std::remove(filename.c_str());
+        }
+    };
+
+    BenchResult result;
+    result.kernel = "batch-" + kernel.name;
+    result.width = width;
+    result.height = height;
+    std::streambuf* console = std::cout.rdbuf();
+    try {
+        std::cout.rdbuf(nullptr); // the engine's own output while the carriers are prepared
+        for (size_t i = 0; i < settings.batchFiles; ++i) {
+            filenames.push_back(settings.directory + "/stego-bench-" + std::to_string(getpid()) + "-batch-"
+                                + std::to_string(size) + "-" + std::to_string(i) + ".bmp");
+            generateBMP(filenames.back(), width, height, kernel.bitsPerPixel, random);
+            std::string& message = messages.emplace_back(64, '\0');
+            for (char& character : message) {
+                character = static_cast<char>('a' + random() % 26);
+            }
+            writeMessageToBMP(filenames.back(), message);
+        }
+        std::cout.rdbuf(console);
+        std::cout.clear();
+        result.carrierBytes = bmpRowStride(width, kernel.bitsPerPixel) * height * filenames.size();
+        result.payloadBytes = 64 * filenames.size();
+        auto dropCaches = [&]() {
+            for (const std::string& filename : filenames) {
+                dropPageCache(filename);
+            }
+        };
+
+        result.operation = "extract-fstream";
+        timeOperation(settings, result, dropCaches, [&]() {
+            for (size_t i = 0; i < filenames.size(); ++i) {
+                if (readMessageFromBMP(filenames[i]) != messages[i]) {
+                    throw std::runtime_error("The extracted message does not match the embedded one.");
+                }
+            }
+        });
+        printBenchResult(settings, result);
+
+        if (!settings.batchCommand.empty()) {
+            result.operation = "extract-process";
+            timeOperation(settings, result, dropCaches, [&]() {
+                for (const std::string& filename : filenames) {
+                    runExtractProcess(settings.batchCommand, filename);
+                }
+            });
+            printBenchResult(settings, result);
+        }
+
+        for (const char* backend : {"pread", "uring"}) {
+            options.ioBackend = backend;
+            try {
+                makeIOBackend(1);
+            } catch (const std::runtime_error& e) {
+                std::cerr << "Skipping extract-" << backend << ": " << e.what() << std::endl;
+                continue;
+            }
+            result.operation = std::string("extract-") + backend;
+            timeOperation(settings, result, dropCaches, [&]() {
+                if (!runBatch(filenames, nullptr)) {
+                    throw std::runtime_error("The batch run failed.");
+                }
+            });
+            printBenchResult(settings, result);
+        }
+        options.ioBackend = "auto";
+    } catch (...) {
+        std::cout.rdbuf(console);
+        std::cout.clear();
+        options.ioBackend = "auto";
+        removeFiles();
+        throw;
+    }
+    removeFiles();
+}
+
+// Function to split a comma separated list
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        parseOptions(argc, argv);
+        BenchSettings settings;
+        settings.csv = options.format == "csv"; // --format csv, anything else prints JSON
+        bool sizesGiven = false;
+        struct stat directoryInfo{};
+        settings.directory = stat("/dev/shm", &directoryInfo) == 0 && S_ISDIR(directoryInfo.st_mode) ? "/dev/shm" : "/tmp";
+        for (int i = 1; i < argc; ++i) {
+            std::string argument = argv[i];
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + argument);
+            }
+            if (argument == "--dir") {
+                settings.directory = argv[++i];
+            } else if (argument == "--sizes") {
+                settings.sizes.clear();
+                sizesGiven = true;
+                for (const std::string& size : splitList(argv[++i])) {
+                    settings.sizes.push_back(std::clamp<size_t>(parseSize(size), 64 << 10, size_t(2) << 30));
+                }
+            } else if (argument == "--kernels") {
+                settings.kernels = splitList(argv[++i]);
+            } else if (argument == "--repeat") {
+                settings.repeat = std::max(1, std::stoi(argv[++i]));
+            } else if (argument == "--batch") {
+                settings.batchFiles = std::stoul(argv[++i]);
+            } else if (argument == "--batch-command") {
+                settings.batchCommand = argv[++i];
+            } else if (argument == "--stc-heights") {
+                for (const std::string& height : splitList(argv[++i])) {
+                    settings.stcHeights.push_back(std::stoul(height));
+                    if (settings.stcHeights.back() < SyndromeTrellisCode::minHeight || settings.stcHeights.back() > SyndromeTrellisCode::maxHeight) {
+                        throw std::runtime_error("Constraint heights go from 4 to 12: " + height);
+                    }
+                }
+            } else {
+                throw std::runtime_error("Unknown argument: " + argument);
+            }
+        }
+        for (const std::string& name : settings.kernels) {
+            if (std::ranges::none_of(benchKernels, [&](const BenchKernel& kernel) { return kernel.name == name; })) {
+                throw std::runtime_error("Unknown kernel: " + name);
+            }
+        }
+
+        if (settings.csv) {
+            std::cout << "kernel,operation,width,height,carrier_bytes,payload_bytes,best_seconds,mean_seconds,"
+                         "mb_per_s,cycles_per_byte,allocations,allocated_bytes,pool_allocations,payload_bits_per_s" << std::endl;
+        }
+        std::mt19937_64 random(0x5eed);
+        if (settings.batchFiles > 0) {
+            if (!sizesGiven) {
+                settings.sizes = {256 << 10};
+            }
+            for (size_t size : settings.sizes) {
+                runBatchBenchCase(settings, size, random);
+            }
+            return 0;
+        }
+        for (const BenchKernel& kernel : benchKernels) {
+            if (!settings.kernels.empty() && std::ranges::find(settings.kernels, kernel.name) == settings.kernels.end()) {
+                continue;
+            }
+            for (size_t size : settings.sizes) {
+                runBenchCase(settings, kernel, size, random);
+            }
+        }
+        for (unsigned height : settings.stcHeights) {
+            options.embedding.mode = "stc";
+            options.embedding.stcHeight = height;
+            for (const BenchKernel& kernel : benchKernels) {
+                if (kernel.png || (!settings.kernels.empty() && std::ranges::find(settings.kernels, kernel.name) == settings.kernels.end())) {
+                    continue;
+                }
+                BenchKernel coded = kernel;
+                coded.name += "-stc-h" + std::to_string(height);
+                for (size_t size : settings.sizes) {
+                    runBenchCase(settings, coded, size, random);
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
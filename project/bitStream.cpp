@@ -0,0 +1,215 @@
+// Bit level access to messages, used by every embed and extract path instead of strings of '0'/'1' characters.
+// Bits are in message order: the bytes one after another, most significant bit first.
+
+// Reads the bits of a message followed by the end of message marker (16 zero bits).
+// The message bytes are loaded 64 bits at a time; nothing is allocated or copied.
+class BitReader {
+public:
+    static constexpr size_t markerBits = 16;
+
+    BitReader() = default;
+    explicit BitReader(const std::string& message) {
+        if (embeddingOptions().checksums) { // the blocks and their checksums (blockChecksums.cpp), shared by copies
+            payload = std::make_shared<const std::string>(messagePayload(message));
+        }
+        const std::string& bitsFrom = payload ? *payload : message;
+        data = reinterpret_cast<const unsigned char*>(bitsFrom.data());
+        bytes = bitsFrom.length();
+        totalBits = bytes * 8 + markerBits;
+    }
+
+    // Function to get the next bit, 0 or 1; past the end only zeros follow
+    unsigned next() {
+        if ((cursor & 63) == 0) {
+            load();
+        }
+        unsigned bit = word >> 63;
+        word <<= 1;
+        ++cursor;
+        return bit;
+    }
+
+    // Function to get the next count bits (at most 32) as a number, the first bit most significant
+    unsigned next(unsigned count) {
+        size_t left = 64 - (cursor & 63);
+        if ((cursor & 63) == 0 || count > left) {
+            unsigned value = 0;
+            for (unsigned i = 0; i < count; ++i) {
+                value = (value << 1) | next();
+            }
+            return value;
+        }
+        unsigned value = static_cast<unsigned>(word >> (64 - count));
+        word <<= count;
+        cursor += count;
+        return value;
+    }
+
+    // Function to continue at bit position, e.g. the first bit of a band embedded by another thread
+    void seek(size_t position) {
+        cursor = position & ~size_t(63);
+        load();
+        word <<= position & 63;
+        cursor = position;
+    }
+
+    bool done() const { return cursor >= totalBits; }
+    size_t size() const { return totalBits; }
+    size_t position() const { return cursor; }
+    size_t remaining() const { return totalBits - std::min(cursor, totalBits); }
+
+private:
+    // Function to load the 64 bits starting at cursor (a multiple of 64), message bytes are big endian in the word
+    void load() {
+        size_t first = cursor / 8;
+        word = 0;
+        if (first + 8 <= bytes) {
+            uint64_t raw;
+            std::memcpy(&raw, data + first, 8);
+            word = __builtin_bswap64(raw);
+            return;
+        }
+        for (size_t i = 0; i < 8; ++i) {
+            word <<= 8;
+            if (first + i < bytes) {
+                word |= data[first + i];
+            }
+        }
+    }
+
+    std::shared_ptr<const std::string> payload; // with --checksums
+    const unsigned char* data = nullptr;
+    size_t bytes = 0;
+    size_t totalBits = 0;
+    size_t cursor = 0;
+    uint64_t word = 0;
+};
+
+// Collects extracted bits into message bytes and recognises the end of message marker.
+// A zero byte followed by another zero byte ends the message; a zero byte followed by anything else
+// belongs to the message. Bits are gathered in a 64 bit word and only complete bytes touch the message.
+// With --checksums every block is verified as soon as its checksum is complete and finish() throws
+// naming the damaged blocks.
+class BitWriter {
+public:
+    explicit BitWriter(std::string& message) : message(message) {}
+
+    // Function to append one bit; returns true once the end of message marker is complete
+    bool push(unsigned bit) {
+        word = (word << 1) | bit;
+        if (++bitCount == 8) {
+            bitCount = 0;
+            return completeByte(static_cast<unsigned char>(word));
+        }
+        return false;
+    }
+
+    // Function to finish when no more bits follow: a pending zero byte is part of the message
+    void finish() {
+        if (pendingZero && !endFound) {
+            append('\0');
+            pendingZero = false;
+        }
+        finishBlocks();
+        if (!damagedBlocks.empty()) {
+            std::string error = "The message is damaged, checksum mismatch in block";
+            error += damagedBlocks.size() > 1 ? "s" : "";
+            for (size_t i = 0; i < damagedBlocks.size(); ++i) {
+                size_t first = damagedBlocks[i] * checksumBlockBytes;
+                error += (i > 0 ? ", " : " ") + std::to_string(damagedBlocks[i]) + " (bytes " + std::to_string(first) + " to "
+                         + std::to_string(std::min(first + checksumBlockBytes, std::max(message.length(), first + 1)) - 1) + ")";
+            }
+            throw std::runtime_error(error + ".");
+        }
+    }
+
+    // Function to append eight bits at once (between whole bytes only); returns true once the marker is complete
+    bool pushByte(unsigned char byte) {
+        return completeByte(byte);
+    }
+
+    bool done() const { return endFound; }
+
+private:
+    bool completeByte(unsigned char byte) {
+        if (pendingZero) {
+            if (byte == 0) {
+                endFound = true; // End of message marker found
+                finishBlocks();
+                return true;
+            }
+            append('\0');
+            pendingZero = false;
+        }
+        if (byte == 0) {
+            pendingZero = true;
+        } else {
+            append(static_cast<char>(byte));
+        }
+        return false;
+    }
+
+    // Function to add a byte of the payload: to the message, or to the checksum of a complete block
+    void append(char byte) {
+        if (!checksums || blockFill < checksumBlockBytes) {
+            message += byte;
+            ++blockFill;
+            return;
+        }
+        checksum[checksumFill++] = byte;
+        if (checksumFill == checksumBytes) {
+            checkBlock(message.data() + message.length() - blockFill, blockFill);
+            blockFill = checksumFill = 0;
+        }
+    }
+
+    // Function to verify the last block, whose checksum is the last checksumBytes bytes of the payload
+    void finishBlocks() {
+        if (!checksums || blocksFinished) {
+            return;
+        }
+        blocksFinished = true;
+        if (blockFill + checksumFill == 0) {
+            return; // the message ended with a whole block
+        }
+        std::string tail = message.substr(message.length() - blockFill) + std::string(checksum, checksumFill);
+        message.resize(message.length() - blockFill);
+        if (tail.length() <= checksumBytes) { // no room for a block and its checksum
+            damagedBlocks.push_back(blockIndex);
+            return;
+        }
+        message.append(tail, 0, tail.length() - checksumBytes);
+        std::memcpy(checksum, tail.data() + tail.length() - checksumBytes, checksumBytes);
+        checkBlock(message.data() + message.length() - (tail.length() - checksumBytes), tail.length() - checksumBytes);
+    }
+
+    // Function to compare the checksum of a block with the one extracted after it
+    void checkBlock(const char* block, size_t length) {
+        char expected[checksumBytes];
+        blockChecksum(block, length, blockIndex, expected);
+        if (std::memcmp(expected, checksum, checksumBytes) != 0) {
+            damagedBlocks.push_back(blockIndex);
+        }
+        ++blockIndex;
+    }
+
+    std::string& message;
+    uint64_t word = 0;
+    int bitCount = 0;
+    bool pendingZero = false;
+    bool endFound = false;
+    bool checksums = embeddingOptions().checksums;
+    size_t blockFill = 0;    // bytes of the current block in message
+    char checksum[checksumBytes];
+    size_t checksumFill = 0; // bytes of its checksum extracted so far
+    size_t blockIndex = 0;
+    bool blocksFinished = false;
+    std::vector<size_t> damagedBlocks;
+};
+
+// Function to set the least significant bit of a carrier byte; modified counts the bytes that change,
+// which decides what is written back (see DirtyRanges) and feeds --stats
+inline void setCarrierBit(char& byte, unsigned bit, size_t& modified) {
+    modified += (byte ^ bit) & 1;
+    byte = static_cast<char>((byte & ~1) | bit);
+}
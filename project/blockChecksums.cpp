@@ -0,0 +1,85 @@
+// --checksums: the message is embedded in blocks of checksumBlockBytes bytes, each followed by a hash of
+// it, so that extraction can tell which part of a message damaged carrier bytes hit instead of returning
+// it silently corrupted. The hash is XXH64 (xxHash), a fast non-cryptographic 64 bit hash, seeded with the
+// number of the block so blocks that trade places are caught too. 56 bits of it are stored as
+// checksumBytes bytes of 7 bits with the high bit set: a checksum never contains the zero bytes of the
+// end of message marker. The last block may be shorter. BitWriter verifies every block as soon as its
+// checksum has been extracted, the last one when the marker arrives, and strips the checksums.
+// Extraction has to be given --checksums as well.
+
+const size_t checksumBlockBytes = 1024;
+const size_t checksumBytes = 8;
+
+// Function to get the XXH64 hash of length bytes
+uint64_t xxh64(const char* data, size_t length, uint64_t seed) {
+    const uint64_t prime1 = 0x9e3779b185ebca87ull, prime2 = 0xc2b2ae3d27d4eb4full, prime3 = 0x165667b19e3779f9ull;
+    const uint64_t prime4 = 0x85ebca77c2b2ae63ull, prime5 = 0x27d4eb2f165667c5ull;
+    auto rotate = [](uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); };
+    auto read64 = [](const char* bytes) { uint64_t value; std::memcpy(&value, bytes, 8); return value; };
+    auto round = [&](uint64_t accumulator, uint64_t input) { return rotate(accumulator + input * prime2, 31) * prime1; };
+    const char* end = data + length;
+    uint64_t hash;
+    if (length >= 32) {
+        uint64_t lanes[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+        for (; data + 32 <= end; data += 32) {
+            for (int lane = 0; lane < 4; ++lane) {
+                lanes[lane] = round(lanes[lane], read64(data + lane * 8));
+            }
+        }
+        hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18);
+        for (uint64_t lane : lanes) {
+            hash = (hash ^ round(0, lane)) * prime1 + prime4;
+        }
+    } else {
+        hash = seed + prime5;
+    }
+    hash += length;
+    for (; data + 8 <= end; data += 8) {
+        hash = rotate(hash ^ round(0, read64(data)), 27) * prime1 + prime4;
+    }
+    if (data + 4 <= end) {
+        uint32_t value;
+        std::memcpy(&value, data, 4);
+        hash = rotate(hash ^ (value * prime1), 23) * prime2 + prime3;
+        data += 4;
+    }
+    for (; data < end; ++data) {
+        hash = rotate(hash ^ (static_cast<unsigned char>(*data) * prime5), 11) * prime1;
+    }
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    return hash ^ (hash >> 32);
+}
+
+// Function to write the checksum of block number index of the message to checksum
+void blockChecksum(const char* block, size_t length, size_t index, char* checksum) {
+    uint64_t hash = xxh64(block, length, index);
+    for (size_t i = 0; i < checksumBytes; ++i) {
+        checksum[i] = static_cast<char>(0x80 | ((hash >> (7 * i)) & 0x7f));
+    }
+}
+
+// Function to get the number of bytes embedded for a message of length bytes
+size_t payloadLength(size_t length) {
+    return embeddingOptions().checksums ? length + (length + checksumBlockBytes - 1) / checksumBlockBytes * checksumBytes : length;
+}
+
+// Function to get the bytes embedded for a message: the message itself, or with --checksums its blocks
+// each followed by its checksum
+std::string messagePayload(const std::string& message) {
+    if (!embeddingOptions().checksums) {
+        return message;
+    }
+    std::string payload;
+    payload.reserve(payloadLength(message.length()));
+    for (size_t start = 0, index = 0; start < message.length(); start += checksumBlockBytes, ++index) {
+        size_t length = std::min(checksumBlockBytes, message.length() - start);
+        char checksum[checksumBytes];
+        blockChecksum(message.data() + start, length, index, checksum);
+        payload.append(message, start, length);
+        payload.append(checksum, checksumBytes);
+    }
+    return payload;
+}
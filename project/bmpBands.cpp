@@ -0,0 +1,135 @@
+#include <fcntl.h>  // open
+#include <unistd.h> // pread, pwrite, close
+#include <utility>  // std::pair
+
+// Pixel data of a BMP file is processed in bands of whole rows so that at most
+// options.memoryBudget bytes of it are in memory, whatever the size of the image.
+
+// Function to get the number of bytes of one BMP row, rows are padded to 4 bytes
+size_t bmpRowStride(uint32_t width, uint16_t bitsPerPixel) {
+    return (static_cast<size_t>(width) * bitsPerPixel + 31) / 32 * 4;
+}
+
+// Function to get the size of a band: as many whole rows as fit into the memory budget, at least one
+size_t bmpBandSize(uint32_t width, uint16_t bitsPerPixel) {
+    size_t stride = bmpRowStride(width, bitsPerPixel);
+    return std::max<size_t>(1, options.memoryBudget / stride) * stride;
+}
+
+// Function to open a file, timed and counted for --stats; returns -1 on failure like open
+int openFile(const std::string& filename, int flags) {
+    STATS_TIMER(Open);
+    STATS_ADD(Syscalls, 1);
+    return open(filename.c_str(), flags);
+}
+
+// Function to read exactly size bytes at offset (pread may return less than asked for)
+void readAt(int fd, char* buffer, size_t size, off_t offset) {
+    STATS_TIMER(Read);
+    STATS_ADD(BytesRead, size);
+    while (size > 0) {
+        STATS_ADD(Syscalls, 1);
+        ssize_t count = pread(fd, buffer, size, offset);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            throw std::runtime_error("Could not read image data.");
+        }
+        buffer += count;
+        size -= count;
+        offset += count;
+    }
+}
+
+// Function to write exactly size bytes at offset
+void writeAt(int fd, const char* buffer, size_t size, off_t offset) {
+    STATS_TIMER(Write);
+    STATS_ADD(BytesWritten, size);
+    while (size > 0) {
+        STATS_ADD(Syscalls, 1);
+        ssize_t count = pwrite(fd, buffer, size, offset);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            throw std::runtime_error("Could not write image data.");
+        }
+        buffer += count;
+        size -= count;
+        offset += count;
+    }
+}
+
+// The parts of a band that changed during embedding, in whole 4 KB blocks of the file. Carrier bytes whose
+// LSB already holds the message bit stay as they are, so re-embedding the same or a similar message only
+// writes back the blocks that differ.
+struct DirtyRanges {
+    static constexpr size_t blockSize = 4096;
+    std::vector<std::pair<size_t, size_t>> ranges; // start and end in the band, adjacent blocks merged
+    size_t modifiedBytes = 0;                      // carrier bytes that changed
+
+    // Function to mark bytes start..end of the band as changed
+    void add(size_t start, size_t end) {
+        if (!ranges.empty() && ranges.back().second == start) {
+            ranges.back().second = end;
+        } else {
+            ranges.emplace_back(start, end);
+        }
+    }
+
+    // Function to mark the block of the file that holds byte position of a band of length bytes starting
+    // at offset; positions come in increasing order
+    void addBlockOf(size_t position, size_t length, off_t offset) {
+        if (!ranges.empty() && position < ranges.back().second) {
+            return;
+        }
+        size_t start = position - std::min<size_t>(position, (offset + position) % blockSize);
+        add(start, std::min(length, start + blockSize - (offset + start) % blockSize));
+    }
+
+    // Function to add the ranges of a later part of the band that starts at byte shift of it
+    void append(const DirtyRanges& part, size_t shift) {
+        for (const auto& [start, end] : part.ranges) { // a block shared by two parts is in both
+            size_t from = std::max(start + shift, ranges.empty() ? 0 : ranges.back().second);
+            if (from < end + shift) {
+                add(from, end + shift);
+            }
+        }
+        modifiedBytes += part.modifiedBytes;
+    }
+
+    // Function to start the next band; modifiedBytes keeps counting for the whole file
+    void clear() {
+        ranges.clear();
+    }
+};
+
+// Function to write the changed ranges of a band that starts at offset back into the file
+void writeDirtyRanges(int fd, const char* band, const DirtyRanges& dirty, off_t offset) {
+    for (const auto& [start, end] : dirty.ranges) {
+        writeAt(fd, band + start, end - start, offset + start);
+    }
+}
+
+// Function to flush a modified file to disk when --fsync was given
+void syncFile(int fd) {
+    if (!options.fsync) {
+        return;
+    }
+    STATS_TIMER(Fsync);
+    STATS_ADD(Syscalls, 1);
+    if (fsync(fd) != 0) {
+        throw std::runtime_error("Could not flush the file to disk.");
+    }
+}
+
+// Closes a file descriptor when it goes out of scope
+struct FileDescriptor {
+    int fd;
+    explicit FileDescriptor(int fd) : fd(fd) {}
+    ~FileDescriptor() {
+        if (fd >= 0) {
+            STATS_ADD(Syscalls, 1);
+            close(fd);
+        }
+    }
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+};
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+// Bounded lock-free queue for many producer and many consumer threads (the sequence number ring of
+// D. Vyukov). Every cell carries a sequence number that tells producers and consumers whose turn it is,
+// so a push or pop is one compare-and-swap on the tail or head and no thread ever holds a lock.
+// push waits while the queue is full, which is the backpressure between the stages of pipeline.cpp;
+// pop waits while it is empty and returns false once the producers closed the queue and it drained.
+// Waiting threads spin briefly, then yield, then sleep, and the time they waited is reported.
+
+template <typename T>
+class BoundedQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        mask = size - 1;
+        cells = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Function to add value if there is room; value is moved from only on success
+    bool tryPush(T& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // full: the consumer of this cell's previous lap has not taken it yet
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Function to take the oldest value if there is one
+    bool tryPop(T& value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // empty
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(position + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Function to add value, waiting while the queue is full; adds the time waited to waited
+    void push(T value, std::chrono::nanoseconds& waited) {
+        if (tryPush(value)) {
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned attempt = 0; !tryPush(value); ++attempt) {
+            backOff(attempt);
+        }
+        waited += std::chrono::steady_clock::now() - start;
+    }
+
+    // Function to take the oldest value, waiting while the queue is empty; false once it is closed and
+    // empty. Adds the time waited to waited.
+    bool pop(T& value, std::chrono::nanoseconds& waited) {
+        if (tryPop(value)) {
+            return true;
+        }
+        auto start = std::chrono::steady_clock::now();
+        bool popped = false;
+        for (unsigned attempt = 0;; ++attempt) {
+            bool wasClosed = closed.load(std::memory_order_acquire); // read before trying, so no late push is missed
+            if (tryPop(value)) {
+                popped = true;
+                break;
+            }
+            if (wasClosed) {
+                break;
+            }
+            backOff(attempt);
+        }
+        waited += std::chrono::steady_clock::now() - start;
+        return popped;
+    }
+
+    // Function to tell the consumers that nothing more will be pushed
+    void close() {
+        closed.store(true, std::memory_order_release);
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static void backOff(unsigned attempt) {
+        if (attempt < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else if (attempt < 128) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0}; // next position to pop
+    alignas(64) std::atomic<size_t> tail{0}; // next position to push
+    alignas(64) std::atomic<bool> closed{false};
+};
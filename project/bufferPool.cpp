@@ -0,0 +1,184 @@
+#include <atomic>
+#include <new>        // placement new
+#include <sys/mman.h> // mmap, madvise
+#include <thread>
+#include <utility>    // std::exchange
+
+// Reusable buffers for image data. Every thread has its own pool (BufferPool::local()), buffers are handed out
+// uninitialised and go back to the pool of their thread when they are destroyed, so a batch run reuses the
+// same memory for file after file instead of allocating and zero-filling a fresh vector for each one.
+// A buffer destroyed on another thread (the pipeline of pipeline.cpp reads on one thread and writes on
+// another) is pushed onto a lock-free list of its pool, which the owning thread takes over on its next
+// acquire. A thread must not exit while buffers of its pool are still in use elsewhere.
+// Buffers from 2 MB up are mapped directly and marked for transparent huge pages where the system has them.
+
+class BufferPool;
+
+// A buffer from a BufferPool; moves like a unique_ptr and returns its memory to the pool when destroyed
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    PooledBuffer(BufferPool* pool, char* memory, size_t capacity, size_t size)
+        : pool(pool), memory(memory), capacity(capacity), length(size) {}
+    PooledBuffer(PooledBuffer&& other) noexcept { *this = std::move(other); }
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+    ~PooledBuffer();
+
+    char* data() { return memory; }
+    const char* data() const { return memory; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    char* begin() { return memory; }
+    char* end() { return memory + length; }
+    const char* begin() const { return memory; }
+    const char* end() const { return memory + length; }
+    char& operator[](size_t index) { return memory[index]; }
+    const char& operator[](size_t index) const { return memory[index]; }
+
+    // Function to shrink the buffer; the capacity stays with it until it goes back to the pool
+    void shrink(size_t size) { length = std::min(length, size); }
+
+private:
+    BufferPool* pool = nullptr;
+    char* memory = nullptr;
+    size_t capacity = 0;
+    size_t length = 0;
+};
+
+class BufferPool {
+public:
+    static constexpr size_t smallestBuffer = 64 * 1024;
+    static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+    static constexpr size_t maxCachedBytes = size_t(1) << 30; // memory a pool keeps for reuse
+
+    BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    ~BufferPool() {
+        takeReturned();
+        for (const auto& [capacity, memory] : freeBuffers) {
+            deallocate(memory, capacity);
+        }
+    }
+
+    // The pool of the calling thread
+    static BufferPool& local() {
+        thread_local BufferPool pool;
+        return pool;
+    }
+
+    // Function to get a buffer of size bytes; its contents are not initialised
+    PooledBuffer acquire(size_t size) {
+        if (returned.load(std::memory_order_relaxed)) {
+            takeReturned();
+        }
+        size_t capacity = sizeClass(size);
+        for (size_t i = 0; i < freeBuffers.size(); ++i) {
+            if (freeBuffers[i].first == capacity) {
+                char* memory = freeBuffers[i].second;
+                freeBuffers[i] = freeBuffers.back();
+                freeBuffers.pop_back();
+                cachedBytes -= capacity;
+                ++reuses;
+                return {this, memory, capacity, size};
+            }
+        }
+        ++allocations;
+        return {this, allocate(capacity), capacity, size};
+    }
+
+    // Function to take a buffer back; kept for reuse while the pool holds less than maxCachedBytes
+    void recycle(char* memory, size_t capacity) {
+        if (std::this_thread::get_id() != owner) {
+            // The buffer itself holds the list node (buffers are at least smallestBuffer bytes)
+            auto node = new (memory) ReturnedBuffer{returned.load(std::memory_order_relaxed), capacity};
+            while (!returned.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+            return;
+        }
+        if (cachedBytes + capacity > maxCachedBytes) {
+            deallocate(memory, capacity);
+            return;
+        }
+        freeBuffers.emplace_back(capacity, memory);
+        cachedBytes += capacity;
+    }
+
+    size_t allocations = 0; // buffers that had to be allocated
+    size_t reuses = 0;      // buffers handed out again from the pool
+
+private:
+    struct ReturnedBuffer {
+        ReturnedBuffer* next;
+        size_t capacity;
+    };
+
+    // Function to move the buffers returned by other threads to the free buffers of this pool
+    void takeReturned() {
+        ReturnedBuffer* node = returned.exchange(nullptr, std::memory_order_acquire);
+        while (node) {
+            ReturnedBuffer* next = node->next;
+            size_t capacity = node->capacity;
+            recycle(reinterpret_cast<char*>(node), capacity);
+            node = next;
+        }
+    }
+
+    // Buffer sizes are powers of two, so buffers of similar size can replace each other
+    static size_t sizeClass(size_t size) {
+        size_t capacity = smallestBuffer;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    static char* allocate(size_t capacity) {
+        if (capacity < hugePageSize) {
+            return static_cast<char*>(::operator new(capacity));
+        }
+        void* memory = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(memory, capacity, MADV_HUGEPAGE);
+#endif
+        return static_cast<char*>(memory);
+    }
+
+    static void deallocate(char* memory, size_t capacity) {
+        if (capacity < hugePageSize) {
+            ::operator delete(memory);
+        } else {
+            munmap(memory, capacity);
+        }
+    }
+
+    std::vector<std::pair<size_t, char*>> freeBuffers; // capacity and memory of the buffers ready for reuse
+    size_t cachedBytes = 0;
+    std::thread::id owner = std::this_thread::get_id();
+    std::atomic<ReturnedBuffer*> returned{nullptr}; // buffers given back by other threads
+};
+
+inline PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept {
+    if (this != &other) {
+        if (pool) {
+            pool->recycle(memory, capacity);
+        }
+        pool = std::exchange(other.pool, nullptr);
+        memory = std::exchange(other.memory, nullptr);
+        capacity = std::exchange(other.capacity, 0);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+inline PooledBuffer::~PooledBuffer() {
+    if (pool) {
+        pool->recycle(memory, capacity);
+    }
+}
@@ -0,0 +1,44 @@
+// Function to count the palette indices of a PNG file that have a partner entry, the ones that carry
+// message bits. Decoding stops at the first row when the palette has an even number of entries, as then
+// every index has one.
+size_t countPairedPaletteIndices(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open PNG file.");
+    }
+    PNGInfo info;
+    readPNGHeader(file, info);
+    size_t count = 0;
+    bool allPaired = false;
+    streamPNGRows(file, info, [&](const char* row, size_t length) {
+        int paired = pairedPaletteEntries(info);
+        if (paired == info.paletteEntries) {
+            allPaired = true;
+            return false;
+        }
+        count += std::count_if(row, row + length, [paired](char index) { return static_cast<unsigned char>(index) < paired; });
+        return true;
+    });
+    return allPaired ? static_cast<size_t>(info.width) * info.height : count;
+}
+
+// Function to check if a message can be written to an image.
+// Only the header is needed, and it comes from the metadata cache when --cache has the file. Palette PNGs
+// whose last palette entry has no partner are the exception: the indices of that entry carry no message
+// bit, so a message within the header bound is checked against a count of the paired indices.
+bool canWriteMessage(const std::string& filename, const std::string& message) {
+    TRACE_FILE(filename);
+    std::string fileExtension = fileExtensionOf(filename);
+    if (fileExtension != "bmp" && fileExtension != "png") {
+        throw std::runtime_error("Unsupported file format.");
+    }
+    ImageInfo image = readCachedImageInfo(filename, readFileStatus(filename));
+    size_t messageBits = (payloadLength(message.length()) + 2) * 8; // +2 for the two null terminators.
+    if (codedEmbedding() && fileExtension == "bmp") {
+        return embeddingCarrierBytes(messageBits) <= image.carrierSamples;
+    }
+    if (messageBits > image.pixels) {
+        return false;
+    }
+    return image.colorType != "palette" || messageBits <= countPairedPaletteIndices(filename);
+}
@@ -3,10 +3,32 @@ void displayHelp() {
     std::cout << "Usage: steganography [flag] [arguments]" << std::endl;
     std::cout << "Supported file extensions: .bmp, .png" << std::endl;
     std::cout << "Flags:" << std::endl;
-    std::cout << "  -i, --info <file_path>        : Display information about the image file." << std::endl;
+    std::cout << "  -i, --info <path>...          : Display information about the image files; directories are searched for them." << std::endl;
     std::cout << "  -e, --encrypt <file_path> <message>: Encrypt the message into the image file." << std::endl;
+    std::cout << "  -u, --update <file_path>... <message>: Replace the message of the image files, rewriting only what changed." << std::endl;
     std::cout << "  -d, --decrypt <file_path>        : Decrypt the message from the image file." << std::endl;
     std::cout << "  -c, --check <file_path> <message>  : Check if the message can be written to the image file." << std::endl;
+    std::cout << "  -a, --analyze <file_path>... : Chi-square and RS steganalysis of the image files (--format json or csv too)." << std::endl;
     std::cout << "  -h, --help                   : Display this help information." << std::endl;
+    std::cout << "  -e <file_path>... <message>  : Batch run, encrypt the message into every file." << std::endl;
+    std::cout << "  -d <file_path>...            : Batch run, decrypt the messages of every file." << std::endl;
     std::cout << "  Running the program without any flags is equivalent to using the -h flag." << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --memory-budget <size>       : Most image data kept in memory at once, e.g. 512K, 64M (default 64M)." << std::endl;
+    std::cout << "  --io <auto|uring|pread>      : I/O backend for batch runs (default auto: io_uring where available)." << std::endl;
+    std::cout << "  --queue-depth <n>            : Files in flight during a batch run or --info (default 64)." << std::endl;
+    std::cout << "  --embedding <mode>           : How BMP carriers hold the message: lsb, matching (changes by +-1)," << std::endl;
+    std::cout << "                                 hamming<k> (k = 2..8, fewer changes) or stc<h> (h = 4..12, fewest, slowest)." << std::endl;
+    std::cout << "  --stc-width <w>              : Carrier bytes per message bit with --embedding stc (default 4)." << std::endl;
+    std::cout << "  --checksums                  : Embed a checksum after every 1 KB of the message; extraction reports damaged blocks." << std::endl;
+    std::cout << "                                 Messages embedded with it are extracted with it." << std::endl;
+    std::cout << "  --seed <n>                   : Seed of the +1/-1 choices of --embedding matching (default: new every run)." << std::endl;
+    std::cout << "  --pipeline <r>,<c>,<w>       : Run a batch with r reader, c compute and w writer threads." << std::endl;
+    std::cout << "  --stats                      : Print the time spent in each phase and I/O counters at the end." << std::endl;
+    std::cout << "  --trace <file>               : Write a trace of the run (chrome://tracing / Perfetto JSON) to file." << std::endl;
+    std::cout << "  --fsync                      : Flush every modified image to disk before reporting success." << std::endl;
+    std::cout << "  --format <text|json|csv>     : Output of --info (default text); json prints one object per file." << std::endl;
+    std::cout << "  --cache <file>               : Keep the image headers read by --info and --check in file for later runs." << std::endl;
+    std::cout << "  --serve <socket>             : Answer requests of --connect clients on a Unix socket until stopped." << std::endl;
+    std::cout << "  --connect <socket>           : Run -i, -e, -d or -c on the server listening on socket." << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+// Dispatch to the --embedding mode for BMP carriers: plain LSB replacement or LSB matching
+// (lsbMatching.cpp), both in embedBandBits, a Hamming code (matrixEmbedding.cpp) or a syndrome-trellis
+// code (syndromeTrellis.cpp). The codes embed in units, a group or a segment of carrier bytes, that have
+// to stay together in one band. collectBand in tryal.cpp is the extraction side.
+
+// Function to tell whether the mode embeds with a code; lsb and matching put one bit into every byte
+bool codedEmbedding() {
+    return selectedHammingCode() || selectedTrellisCode();
+}
+
+// Function to get the carrier bytes a band has to be a multiple of; 1 for plain LSB embedding
+size_t embeddingUnitBytes() {
+    if (const HammingCode* code = selectedHammingCode()) {
+        return code->groupSize();
+    }
+    if (const SyndromeTrellisCode* code = selectedTrellisCode()) {
+        return code->segmentBytes();
+    }
+    return 1;
+}
+
+// Function to get the carrier bytes needed for messageBits bits (message and marker)
+size_t embeddingCarrierBytes(size_t messageBits) {
+    if (const HammingCode* code = selectedHammingCode()) {
+        return code->carrierBytes(messageBits);
+    }
+    if (const SyndromeTrellisCode* code = selectedTrellisCode()) {
+        return code->carrierBytes(messageBits);
+    }
+    return messageBits;
+}
+
+// Function to embed the next message bits into a band of pixel data that starts at offset in the file
+void embedBand(char* data, size_t length, BitReader& bits, off_t offset, DirtyRanges& dirty) {
+    if (const HammingCode* code = selectedHammingCode()) {
+        embedBandHamming(*code, data, length, bits, offset, dirty);
+    } else if (const SyndromeTrellisCode* code = selectedTrellisCode()) {
+        embedBandSTC(*code, data, length, bits, offset, dirty);
+    } else {
+        embedBandBits(data, length, bits, offset, dirty);
+    }
+}
@@ -0,0 +1,77 @@
+#include <fcntl.h> // AT_FDCWD
+#ifdef __linux__
+#include <sys/sysmacros.h> // makedev
+#endif
+
+// The file status --info reports, with the device and inode that identify the file in the metadata cache.
+// On Linux it comes from statx asking only for the inode, size, times and mode, so network file systems
+// such as NFS do not have to fetch the other attributes; elsewhere, or when the kernel has no statx, it
+// comes from stat.
+
+struct FileStatus {
+    dev_t device = 0;
+    ino_t inode = 0;
+    off_t size = 0;
+    mode_t mode = 0;
+    timespec accessTime{};
+    timespec modificationTime{};
+    timespec statusChangeTime{};
+};
+
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+// Attributes --info needs; the device is always returned
+const unsigned int fileStatusMask = STATX_TYPE | STATX_MODE | STATX_INO | STATX_SIZE | STATX_ATIME | STATX_MTIME | STATX_CTIME;
+#endif
+
+// Function to fill status from stat; returns false and leaves errno set if it failed
+bool statFileStatus(const std::string& filename, FileStatus& status) {
+    struct stat fileInfo{};
+    if (stat(filename.c_str(), &fileInfo) != 0) {
+        return false;
+    }
+    status.device = fileInfo.st_dev;
+    status.inode = fileInfo.st_ino;
+    status.size = fileInfo.st_size;
+    status.mode = fileInfo.st_mode;
+#ifdef __APPLE__
+    status.accessTime = fileInfo.st_atimespec;
+    status.modificationTime = fileInfo.st_mtimespec;
+    status.statusChangeTime = fileInfo.st_ctimespec;
+#else
+    status.accessTime = fileInfo.st_atim;
+    status.modificationTime = fileInfo.st_mtim;
+    status.statusChangeTime = fileInfo.st_ctim;
+#endif
+    return true;
+}
+
+// Function to get the status of a file, following symbolic links like stat
+FileStatus readFileStatus(const std::string& filename) {
+    STATS_TIMER(Open);
+    STATS_ADD(Syscalls, 1);
+    FileStatus status;
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+    static std::atomic<bool> statxMissing{false};
+    if (!statxMissing.load(std::memory_order_relaxed)) {
+        struct statx fileInfo{};
+        if (statx(AT_FDCWD, filename.c_str(), 0, fileStatusMask, &fileInfo) == 0) {
+            status.device = makedev(fileInfo.stx_dev_major, fileInfo.stx_dev_minor);
+            status.inode = fileInfo.stx_ino;
+            status.size = static_cast<off_t>(fileInfo.stx_size);
+            status.mode = fileInfo.stx_mode;
+            status.accessTime = {static_cast<time_t>(fileInfo.stx_atime.tv_sec), fileInfo.stx_atime.tv_nsec};
+            status.modificationTime = {static_cast<time_t>(fileInfo.stx_mtime.tv_sec), fileInfo.stx_mtime.tv_nsec};
+            status.statusChangeTime = {static_cast<time_t>(fileInfo.stx_ctime.tv_sec), fileInfo.stx_ctime.tv_nsec};
+            return status;
+        }
+        if (errno != ENOSYS) {
+            throw std::runtime_error(strerror(errno));
+        }
+        statxMissing.store(true, std::memory_order_relaxed); // kernel older than 4.11
+    }
+#endif
+    if (!statFileStatus(filename, status)) {
+        throw std::runtime_error(strerror(errno));
+    }
+    return status;
+}
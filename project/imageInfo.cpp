@@ -0,0 +1,112 @@
+// Image information for --info without reading any pixel data: the header fields come from one read of
+// the start of the file. For PNG files the chunks before the image data are counted as well; the walk
+// stops at the first IDAT, and a chunk header only needs a read of its own when large ancillary chunks
+// (iCCP, eXIf, ...) push it past that first read.
+
+// Size of the one read at the start of the file, enough for the headers and the chunks before the image data
+const size_t imageInfoReadSize = 4096;
+
+struct ImageInfo {
+    std::string format;        // "bmp" or "png"
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint16_t bitsPerPixel = 0;
+    uint16_t bitDepth = 0;     // bits per sample
+    std::string colorType;
+    bool interlaced = false;
+    size_t rowStride = 0;      // bytes per row, without the PNG filter type byte
+    size_t headerChunks = 0;   // PNG only: chunks before the image data, IHDR included
+    size_t carrierSamples = 0; // bytes or samples that can carry message bits
+    size_t pixels = 0;         // pixels -e and -c count, one message bit each
+    size_t maxMessage = 0;     // longest message -e and -c accept (one bit per pixel)
+    // capacity[k - 1]: message bytes that fit with k LSBs of every carrier sample, end of message marker excluded
+    std::array<size_t, 8> capacity{};
+};
+
+// Reads from a block of memory through std::istream, so the stream parsers can work on a buffer
+struct MemoryStreamBuffer : std::streambuf {
+    MemoryStreamBuffer(char* data, size_t size) { setg(data, data, data + size); }
+};
+
+// Function to fill in the capacities for carrierSamples and the pixel count
+void computeImageCapacity(ImageInfo& image, size_t pixels) {
+    image.pixels = pixels;
+    for (size_t depth = 1; depth <= image.capacity.size(); ++depth) {
+        size_t bytes = image.carrierSamples * depth / 8;
+        image.capacity[depth - 1] = bytes > 2 ? bytes - 2 : 0;
+    }
+    size_t availableBytes = pixels / 8;
+    image.maxMessage = availableBytes > 2 ? availableBytes - 2 : 0;
+}
+
+// Function to read the image information of a BMP or PNG file of fileSize bytes
+ImageInfo readImageInfo(const std::string& filename, off_t fileSize) {
+    STATS_TIMER(HeaderParse);
+    FileDescriptor fd(openFile(filename, O_RDONLY));
+    if (fd.fd < 0) {
+        throw std::runtime_error(strerror(errno));
+    }
+    char header[imageInfoReadSize];
+    size_t headerSize = std::min<size_t>(imageInfoReadSize, fileSize);
+    readAt(fd.fd, header, headerSize, 0);
+
+    ImageInfo image;
+    image.format = fileExtensionOf(filename);
+    if (image.format == "bmp") {
+        if (headerSize < bmpHeaderSize) {
+            throw std::runtime_error("Not a valid BMP file.");
+        }
+        uint32_t dataOffset = parseBMPHeader(header, image.width, image.height, image.bitsPerPixel);
+        if (static_cast<off_t>(dataOffset) > fileSize) {
+            throw std::runtime_error("Not a valid BMP file.");
+        }
+        image.bitDepth = 8;
+        image.colorType = image.bitsPerPixel == 32 ? "BGRA" : "BGR";
+        image.rowStride = bmpRowStride(image.width, image.bitsPerPixel);
+        image.carrierSamples = fileSize - dataOffset; // every byte of the pixel data, row padding included
+        computeImageCapacity(image, image.carrierSamples * 8 / image.bitsPerPixel);
+        return image;
+    }
+    if (image.format != "png") {
+        throw std::runtime_error("Unsupported file format.");
+    }
+
+    PNGInfo info;
+    MemoryStreamBuffer memory(header, headerSize);
+    std::istream stream(&memory);
+    try {
+        readPNGHeader(stream, info);
+    } catch (const std::runtime_error&) {
+        throw std::runtime_error("Not a valid PNG file.");
+    }
+    const char* colorTypes[] = {"gray", "", "RGB", "palette", "gray+alpha", "", "RGBA"};
+    image.width = info.width;
+    image.height = info.height;
+    image.bitDepth = info.bitDepth;
+    image.bitsPerPixel = info.channels * info.bitDepth;
+    image.colorType = colorTypes[info.colorType];
+    image.interlaced = info.interlaceMethod == 1;
+    image.rowStride = info.stride;
+    image.carrierSamples = static_cast<size_t>(info.width) * info.height * info.channels; // palette: every index
+    computeImageCapacity(image, static_cast<size_t>(info.width) * info.height);
+
+    // Walk the chunk headers up to the first IDAT: IHDR ends at offset 33
+    image.headerChunks = 1;
+    for (off_t offset = 33; offset + 12 <= fileSize;) {
+        char chunkHeader[8];
+        if (offset + 8 <= static_cast<off_t>(headerSize)) {
+            std::memcpy(chunkHeader, header + offset, 8);
+        } else {
+            readAt(fd.fd, chunkHeader, 8, offset);
+        }
+        uint32_t length;
+        std::memcpy(&length, chunkHeader, 4);
+        length = __builtin_bswap32(length);
+        if (std::memcmp(chunkHeader + 4, "IDAT", 4) == 0 || std::memcmp(chunkHeader + 4, "IEND", 4) == 0) {
+            break;
+        }
+        ++image.headerChunks;
+        offset += 12 + static_cast<off_t>(length);
+    }
+    return image;
+}
@@ -0,0 +1,173 @@
+#include <cstdio>
+#include <fmt/format.h>
+#include <fmt/ranges.h> // fmt::join
+
+// Machine readable --info output (--format json or csv).
+// All fields of a file are formatted into one buffer with fmt and the records of many files are
+// written out together, so a run over thousands of files makes a handful of writes instead of
+// flushing std::cout after every line.
+// JSON output has one object per line; CSV output starts with a header row. Times are seconds since the
+// epoch with nanoseconds.
+
+// Function to append text as a JSON string, with quotes
+void appendJSONString(fmt::memory_buffer& buffer, std::string_view text) {
+    buffer.push_back('"');
+    for (unsigned char character : text) {
+        if (character == '"' || character == '\\') {
+            buffer.push_back('\\');
+            buffer.push_back(static_cast<char>(character));
+        } else if (character < 0x20) {
+            fmt::format_to(std::back_inserter(buffer), "\\u{:04x}", character);
+        } else {
+            buffer.push_back(static_cast<char>(character));
+        }
+    }
+    buffer.push_back('"');
+}
+
+// Function to append text as a CSV field, quoted when it holds a separator, quote or line break
+void appendCSVField(fmt::memory_buffer& buffer, std::string_view text) {
+    if (text.find_first_of(",\"\r\n") == std::string_view::npos) {
+        buffer.append(text);
+        return;
+    }
+    buffer.push_back('"');
+    for (char character : text) {
+        if (character == '"') {
+            buffer.push_back('"');
+        }
+        buffer.push_back(character);
+    }
+    buffer.push_back('"');
+}
+
+// Function to get the permissions of a mode as in ls, e.g. rw-r--r--
+std::string_view permissionString(mode_t mode, char (&text)[10]) {
+    const char flags[] = "rwxrwxrwx";
+    for (int i = 0; i < 9; ++i) {
+        text[i] = mode & (0400 >> i) ? flags[i] : '-';
+    }
+    return {text, 9};
+}
+
+class InfoWriter {
+public:
+    static constexpr size_t flushSize = 64 * 1024; // records collected before they are written
+
+    explicit InfoWriter(bool csv) : csv(csv) {
+        if (csv) {
+            buffer.append(std::string_view("file,size,access_time,modification_time,status_change_time,mode,permissions,"
+                                           "width,height,bits_per_pixel,color_type,interlaced,row_stride,header_chunks,max_message,"
+                                           "capacity_lsb1,capacity_lsb2,capacity_lsb3,capacity_lsb4,"
+                                           "capacity_lsb5,capacity_lsb6,capacity_lsb7,capacity_lsb8,error\n"));
+        }
+    }
+
+    ~InfoWriter() {
+        flush();
+    }
+
+    InfoWriter(const InfoWriter&) = delete;
+    InfoWriter& operator=(const InfoWriter&) = delete;
+
+    // Function to add the record of a file; the fields that could not be read are left out
+    void add(const FileInfoRecord& record) {
+        const FileStatus* status = record.status ? &*record.status : nullptr;
+        const ImageInfo* image = record.image ? &*record.image : nullptr;
+        char permissions[10];
+        char accessTime[epochTimestampSize], modificationTime[epochTimestampSize], statusChangeTime[epochTimestampSize];
+        if (csv) {
+            appendCSVField(buffer, record.filename);
+            if (status) {
+                fmt::format_to(std::back_inserter(buffer), ",{},{},{},{},{:04o},{},", static_cast<long long>(status->size),
+                               formatEpoch(status->accessTime, accessTime),
+                               formatEpoch(status->modificationTime, modificationTime),
+                               formatEpoch(status->statusChangeTime, statusChangeTime), status->mode & 07777,
+                               permissionString(status->mode, permissions));
+            } else {
+                buffer.append(std::string_view(",,,,,,,"));
+            }
+            if (image) {
+                fmt::format_to(std::back_inserter(buffer), "{},{},{},{},{},{},", image->width, image->height,
+                               image->bitsPerPixel, image->colorType, image->interlaced ? 1 : 0, image->rowStride);
+                if (image->format == "png") {
+                    fmt::format_to(std::back_inserter(buffer), "{}", image->headerChunks);
+                }
+                fmt::format_to(std::back_inserter(buffer), ",{},{},", image->maxMessage, fmt::join(image->capacity, ","));
+            } else {
+                buffer.append(std::string_view(",,,,,,,,,,,,,,,,"));
+            }
+            appendCSVField(buffer, record.error);
+            buffer.push_back('\n');
+        } else {
+            buffer.append(std::string_view("{\"file\":"));
+            appendJSONString(buffer, record.filename);
+            if (status) {
+                fmt::format_to(std::back_inserter(buffer),
+                               ",\"size\":{},\"access_time\":{},\"modification_time\":{},\"status_change_time\":{},"
+                               "\"mode\":\"{:04o}\",\"permissions\":\"{}\"",
+                               static_cast<long long>(status->size), formatEpoch(status->accessTime, accessTime),
+                               formatEpoch(status->modificationTime, modificationTime),
+                               formatEpoch(status->statusChangeTime, statusChangeTime), status->mode & 07777,
+                               permissionString(status->mode, permissions));
+            }
+            if (image) {
+                fmt::format_to(std::back_inserter(buffer),
+                               ",\"width\":{},\"height\":{},\"bits_per_pixel\":{},\"color_type\":\"{}\",\"interlaced\":{},"
+                               "\"row_stride\":{}",
+                               image->width, image->height, image->bitsPerPixel, image->colorType, image->interlaced,
+                               image->rowStride);
+                if (image->format == "png") {
+                    fmt::format_to(std::back_inserter(buffer), ",\"header_chunks\":{}", image->headerChunks);
+                }
+                fmt::format_to(std::back_inserter(buffer), ",\"max_message\":{},\"capacity_by_lsb_depth\":[{}]",
+                               image->maxMessage, fmt::join(image->capacity, ","));
+            }
+            if (!record.error.empty()) {
+                buffer.append(std::string_view(",\"error\":"));
+                appendJSONString(buffer, record.error);
+            }
+            buffer.append(std::string_view("}\n"));
+        }
+        flushIfFull();
+    }
+
+    // Function to take the collected records instead of writing them to stdout
+    std::string take() {
+        std::string text(buffer.data(), buffer.size());
+        buffer.clear();
+        return text;
+    }
+
+    // Function to write the collected records to stdout
+    void flush() {
+        if (buffer.size() == 0) {
+            return;
+        }
+        std::cout.flush(); // keep the order with anything already written through std::cout
+        std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+        std::fflush(stdout);
+        buffer.clear();
+    }
+
+private:
+    void flushIfFull() {
+        if (buffer.size() >= flushSize) {
+            flush();
+        }
+    }
+
+    bool csv;
+    fmt::memory_buffer buffer;
+};
+
+// Function to print the records in the --format given; returns false if any file failed
+bool printFileInfoRecords(const std::vector<FileInfoRecord>& records) {
+    InfoWriter writer(options.format == "csv");
+    bool allSucceeded = true;
+    for (const FileInfoRecord& record : records) {
+        writer.add(record);
+        allSucceeded = allSucceeded && record.error.empty();
+    }
+    return allSucceeded;
+}
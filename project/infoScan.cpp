@@ -0,0 +1,87 @@
+#include <filesystem>
+#include <optional>
+#include <thread>
+
+// Gathering the --info of many files. Directories given on the command line are searched for .bmp and
+// .png files, then the status and image header of every file are read by up to options.queueDepth
+// threads at once: on network file systems each lookup waits a round trip, and many of them in flight
+// hide that latency. The records keep the order of the arguments (files of a directory in name order)
+// however the threads finish.
+
+// Everything --info reports about one file
+struct FileInfoRecord {
+    std::string filename;
+    std::optional<FileStatus> status;
+    std::optional<ImageInfo> image;
+    std::string error; // why status or image is missing
+};
+
+// Function to read the status and image information of a file; errors are kept in the record
+FileInfoRecord readFileInfo(const std::string& filename) {
+    TRACE_FILE(filename);
+    FileInfoRecord record;
+    record.filename = filename;
+    std::string extension = fileExtensionOf(filename);
+    if (extension != "bmp" && extension != "png") {
+        record.error = "Unsupported file format. Only .bmp and .png are supported.";
+        return record;
+    }
+    try {
+        record.status = readFileStatus(filename);
+        record.image = readCachedImageInfo(filename, *record.status);
+    } catch (const std::exception& e) {
+        record.error = e.what();
+    }
+    return record;
+}
+
+// Function to replace every directory in paths by the .bmp and .png files below it, sorted by name
+std::vector<std::string> expandInfoPaths(const std::vector<std::string>& paths) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> filenames;
+    for (const std::string& path : paths) {
+        std::error_code error;
+        if (!fs::is_directory(path, error)) {
+            filenames.push_back(path); // a missing file is reported with the other records
+            continue;
+        }
+        size_t first = filenames.size();
+        for (fs::recursive_directory_iterator it(path, fs::directory_options::skip_permission_denied, error), end;
+             !error && it != end; it.increment(error)) {
+            if (!it->is_regular_file(error)) {
+                continue; // directory entries carry their type, so this needs no stat on most file systems
+            }
+            std::string filename = it->path().string();
+            std::string extension = fileExtensionOf(filename);
+            if (extension == "bmp" || extension == "png") {
+                filenames.push_back(std::move(filename));
+            }
+        }
+        if (error) {
+            throw std::runtime_error("Could not search the directory " + path + ": " + error.message());
+        }
+        std::sort(filenames.begin() + first, filenames.end());
+    }
+    return filenames;
+}
+
+// Function to read the information of every file, in the order of filenames
+std::vector<FileInfoRecord> readFileInfoRecords(const std::vector<std::string>& filenames) {
+    std::vector<FileInfoRecord> records(filenames.size());
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        for (size_t i = next++; i < records.size(); i = next++) {
+            records[i] = readFileInfo(filenames[i]);
+        }
+    };
+    size_t threadCount = std::min<size_t>(options.queueDepth, records.size());
+    std::vector<std::jthread> threads;
+    for (size_t i = 1; i < threadCount; ++i) {
+        threads.emplace_back(work);
+    }
+    work(); // the calling thread takes its share too
+    for (std::jthread& thread : threads) {
+        thread.join();
+    }
+    return records;
+}
@@ -0,0 +1,236 @@
+#include <deque>
+#include <memory>
+#include <sys/uio.h> // iovec
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// Asynchronous file I/O for batch runs. Requests for many files are submitted together and
+// completions are handled as they arrive, so reading and writing overlaps with embedding and extraction.
+// Linux uses io_uring; elsewhere, or when io_uring is not available, requests run through open/pread/pwrite.
+
+enum class IOKind { Read, Write, Open };
+
+// One read or write of a byte range, or the open of path; result is the byte count (the file
+// descriptor for an open) or -errno once the request completed
+struct IORequest {
+    IOKind kind = IOKind::Read;
+    int fd = -1;
+    char* buffer = nullptr;
+    size_t size = 0;
+    off_t offset = 0;
+    const char* path = nullptr; // Open only
+    int flags = 0;              // Open only
+    ssize_t result = 0;
+    void* owner = nullptr; // the caller's state for this request
+    iovec vector{};        // used by the io_uring backend
+};
+
+class IOBackend {
+public:
+    virtual ~IOBackend() = default;
+    virtual const char* name() const = 0;
+    // Function to queue a request; it may not start before the next call to waitOne
+    virtual void submit(IORequest* request) = 0;
+    // Function to wait for the next completed request, nullptr when nothing is pending
+    virtual IORequest* waitOne() = 0;
+};
+
+// Fallback backend: every request runs synchronously with open/pread/pwrite when it is submitted
+class PreadBackend : public IOBackend {
+public:
+    const char* name() const override { return "pread"; }
+
+    void submit(IORequest* request) override {
+        if (request->kind == IOKind::Open) {
+            int fd = openFile(request->path, request->flags);
+            request->result = fd < 0 ? -errno : fd;
+            completed.push_back(request);
+            return;
+        }
+        bool write = request->kind == IOKind::Write;
+        STATS_TIMER_FOR(write ? StatPhase::Write : StatPhase::Read);
+        ssize_t count;
+        do {
+            STATS_ADD(Syscalls, 1);
+            count = write ? pwrite(request->fd, request->buffer, request->size, request->offset)
+                          : pread(request->fd, request->buffer, request->size, request->offset);
+        } while (count < 0 && errno == EINTR);
+        request->result = count < 0 ? -errno : count;
+        completed.push_back(request);
+    }
+
+    IORequest* waitOne() override {
+        if (completed.empty()) {
+            return nullptr;
+        }
+        IORequest* request = completed.front();
+        completed.pop_front();
+        return request;
+    }
+
+private:
+    std::deque<IORequest*> completed;
+};
+
+#ifdef __linux__
+// io_uring backend using the raw system calls, so no liburing is needed
+class IOUringBackend : public IOBackend {
+public:
+    explicit IOUringBackend(unsigned entries) {
+        io_uring_params params{};
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0) {
+            throw std::runtime_error("io_uring is not available.");
+        }
+        sqEntries = params.sq_entries;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        cqRing = singleMap ? sqRing
+                           : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+            unmap();
+            throw std::runtime_error("Could not map the io_uring queues.");
+        }
+
+        auto sq = static_cast<char*>(sqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~IOUringBackend() override {
+        unmap();
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    void submit(IORequest* request) override {
+        // Never have more requests in flight than the submission queue holds, so the completion queue cannot overflow
+        while (inFlight >= sqEntries) {
+            reap(true);
+        }
+        unsigned tail = *sqTail;
+        unsigned index = tail & sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        if (request->kind == IOKind::Open) {
+            sqe.opcode = IORING_OP_OPENAT; // Linux 5.6; older kernels complete it with -EINVAL
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uint64_t>(request->path);
+            sqe.open_flags = request->flags | O_CLOEXEC;
+        } else {
+            request->vector.iov_base = request->buffer;
+            request->vector.iov_len = request->size;
+            sqe.opcode = request->kind == IOKind::Write ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe.fd = request->fd;
+            sqe.addr = reinterpret_cast<uint64_t>(&request->vector);
+            sqe.len = 1;
+            sqe.off = request->offset;
+        }
+        sqe.user_data = reinterpret_cast<uint64_t>(request);
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++unsubmitted;
+        ++inFlight;
+    }
+
+    IORequest* waitOne() override {
+        if (completed.empty() && inFlight > 0) {
+            reap(true);
+        }
+        if (completed.empty()) {
+            return nullptr;
+        }
+        IORequest* request = completed.front();
+        completed.pop_front();
+        return request;
+    }
+
+private:
+    // Function to hand queued requests to the kernel and collect every completion that is ready
+    void reap(bool wait) {
+        unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+        long result;
+        do {
+            STATS_ADD(Syscalls, 1);
+            result = syscall(__NR_io_uring_enter, ringFd, unsubmitted, wait ? 1 : 0, flags, nullptr, 0);
+        } while (result < 0 && errno == EINTR);
+        if (result < 0) {
+            throw std::runtime_error("io_uring_enter failed.");
+        }
+        unsubmitted -= std::min<unsigned>(unsubmitted, result);
+
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            auto request = reinterpret_cast<IORequest*>(cqe.user_data);
+            request->result = cqe.res;
+            completed.push_back(request);
+            --inFlight;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    void unmap() {
+        if (sqes && sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing && sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) close(ringFd);
+    }
+
+    int ringFd = -1;
+    unsigned sqEntries = 0;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned unsubmitted = 0;
+    size_t inFlight = 0;
+    std::deque<IORequest*> completed;
+};
+#endif
+
+// Function to create the backend selected with --io (io_uring when available unless pread was asked for)
+std::unique_ptr<IOBackend> makeIOBackend(unsigned queueDepth) {
+#ifdef __linux__
+    if (options.ioBackend != "pread") {
+        try {
+            return std::make_unique<IOUringBackend>(queueDepth);
+        } catch (const std::runtime_error& e) {
+            if (options.ioBackend == "uring") {
+                throw;
+            }
+        }
+    }
+#endif
+    if (options.ioBackend == "uring") {
+        throw std::runtime_error("io_uring is not available on this system.");
+    }
+    return std::make_unique<PreadBackend>();
+}
@@ -0,0 +1,118 @@
+#include <coroutine>
+
+// Coroutines on top of an IOBackend: the work on one file is written as straight-line code that
+// co_awaits its opens, reads and writes, while one thread keeps many such files in flight.
+// An IOTask starts running as soon as it is called and suspends at every I/O request; IOLoop::runOne
+// waits for the next completed request and resumes the task that made it.
+// Phase timers must not span a co_await: other tasks run on the same thread while one is suspended.
+
+class IOTask {
+public:
+    struct promise_type {
+        IOTask get_return_object() { return IOTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; } // kept until the loop has seen it finish
+        void return_void() {}
+        void unhandled_exception() { throw; }
+    };
+
+    explicit IOTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    // Function to give up ownership of the coroutine; IOLoop::runOne hands it back once it finished
+    std::coroutine_handle<> release() { return std::exchange(handle, nullptr); }
+
+    bool done() const { return !handle || handle.done(); }
+
+    IOTask(IOTask&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    IOTask& operator=(IOTask&&) = delete;
+    ~IOTask() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+class IOLoop {
+public:
+    explicit IOLoop(unsigned queueDepth) : backend(makeIOBackend(queueDepth)) {}
+
+    // Awaitable for one request; co_await gives its result, the byte count or file descriptor or -errno
+    class Operation {
+    public:
+        Operation(IOLoop& loop, IORequest request) : loop(loop), request(request) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            handle = coroutine;
+            traceFile = Tracer::currentFile;
+            request.owner = this;
+            if (options.trace) {
+                submitted = std::chrono::steady_clock::now();
+            }
+            loop.backend->submit(&request);
+        }
+
+        ssize_t await_resume() {
+#if STEGO_STATS
+            static const char* const names[] = {"read in flight", "write in flight", "open in flight"};
+            TRACE_IO(names[size_t(request.kind)], submitted, std::chrono::steady_clock::now(), loop.nextAsyncId++);
+#endif
+            if (request.kind == IOKind::Read && request.result > 0) {
+                STATS_ADD(BytesRead, request.result);
+            } else if (request.kind == IOKind::Write && request.result > 0) {
+                STATS_ADD(BytesWritten, request.result);
+            }
+            return request.result;
+        }
+
+    private:
+        friend class IOLoop;
+        IOLoop& loop;
+        IORequest request;
+        std::coroutine_handle<> handle;
+        int traceFile = -1; // file of the spans of the suspended task
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    Operation open(const std::string& path, int flags) {
+        IORequest request;
+        request.kind = IOKind::Open;
+        request.path = path.c_str();
+        request.flags = flags;
+        return {*this, request};
+    }
+
+    Operation read(int fd, char* buffer, size_t size, off_t offset) {
+        return {*this, {IOKind::Read, fd, buffer, size, offset}};
+    }
+
+    Operation write(int fd, char* buffer, size_t size, off_t offset) {
+        return {*this, {IOKind::Write, fd, buffer, size, offset}};
+    }
+
+    // Function to resume the task whose request completes next; returns that task, or nullptr once no
+    // request is pending. The caller destroys a returned task that is done.
+    std::coroutine_handle<> runOne() {
+        IORequest* request;
+        {
+            STATS_TIMER(Wait);
+            request = backend->waitOne();
+        }
+        if (!request) {
+            return nullptr;
+        }
+        Operation& operation = *static_cast<Operation*>(request->owner);
+        std::coroutine_handle<> handle = operation.handle;
+        TRACE_FILE_ID(operation.traceFile);
+        handle.resume();
+        return handle;
+    }
+
+private:
+    std::unique_ptr<IOBackend> backend;
+    int64_t nextAsyncId = 0; // id of the next asynchronous span for --trace
+};
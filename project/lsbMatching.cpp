@@ -0,0 +1,46 @@
+#include <random>
+
+// LSB matching (--embedding matching, also called ±1 embedding): a carrier byte whose LSB is not the
+// message bit is moved by +1 or -1 at random instead of having its LSB overwritten. Replacement only
+// ever swaps the values 2i and 2i+1, which evens out the counts of every such pair and gives it away to
+// a chi-square test; matching moves values into both neighbours. The LSBs end up the same, so extraction
+// is that of plain LSB embedding. 0 can only go up and 255 only down.
+// The random choices come from a counter-based generator (splitmix64 of the position in the file), so
+// every byte gets the same choice however the pixel data is split into bands, and the kernel has no
+// branches on the data.
+
+// Function to get the seed of the random choices: --seed, or a new one for every run
+uint64_t matchingSeed() {
+    static const uint64_t randomSeed = (uint64_t(std::random_device()()) << 32) | std::random_device()();
+    return embeddingOptions().seed ? embeddingOptions().seed : randomSeed;
+}
+
+// Function to get the 64 random bits of the carrier bytes 64 * counter .. 64 * counter + 63 of a file,
+// one bit per byte: 1 for +1
+inline uint64_t matchingRandomBits(uint64_t seed, uint64_t counter) {
+    uint64_t z = seed + (counter + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Function to give length bytes, the first of which is at offset in the file, the next message bits as
+// their LSBs by moving them +1 or -1; returns the number of bytes that changed
+size_t embedBitsMatching(char* data, size_t length, BitReader& bits, off_t offset) {
+    size_t modified = 0;
+    uint64_t seed = matchingSeed();
+    for (size_t i = 0; i < length;) {
+        size_t position = offset + i;
+        size_t count = std::min<size_t>(length - i, 64 - position % 64);
+        uint64_t random = matchingRandomBits(seed, position / 64) >> (position % 64);
+        for (size_t j = 0; j < count; ++j, random >>= 1) {
+            unsigned byte = static_cast<unsigned char>(data[i + j]);
+            unsigned change = (byte ^ bits.next()) & 1;
+            unsigned up = ((random & 1) | (byte == 0)) & (byte != 255); // saturate at 0 and 255
+            data[i + j] = static_cast<char>(byte + change * (2 * up - 1));
+            modified += change;
+        }
+        i += count;
+    }
+    return modified;
+}
@@ -0,0 +1,191 @@
+#include <thread>
+
+// Matrix embedding with (1, 2^k - 1, k) Hamming codes (--embedding hamming<k>, as in F5): k message bits
+// go into a group of n = 2^k - 1 carrier bytes. The bits a group carries are its syndrome, the XOR of the
+// positions 1..n of the bytes whose LSB is set, and embedding flips at most one LSB per group to make the
+// syndrome equal the message bits. LSB replacement changes half the bytes it touches, one per two bits;
+// a Hamming group changes at most one byte per k bits, at the price of n / k carrier bytes per bit.
+// The syndromes come from a table of the contribution of every 8 byte chunk of a group, indexed by
+// the LSBs of the chunk gathered into one byte. Groups are independent, so a large band is split among
+// threads, each starting at its own position of the message (BitReader::seek).
+
+class HammingCode {
+public:
+    static constexpr unsigned maxBits = 8; // groups of up to 255 bytes
+
+    // The code for k message bits per group; tables are built once
+    static const HammingCode& get(unsigned bits) {
+        static const auto codes = []() {
+            std::array<std::unique_ptr<HammingCode>, maxBits + 1> codes;
+            for (unsigned k = 1; k <= maxBits; ++k) {
+                codes[k].reset(new HammingCode(k));
+            }
+            return codes;
+        }();
+        return *codes.at(bits);
+    }
+
+    unsigned bits() const { return k; }
+    size_t groupSize() const { return n; }
+
+    // Function to get the carrier bytes needed for messageBits bits
+    size_t carrierBytes(size_t messageBits) const {
+        return (messageBits + k - 1) / k * n;
+    }
+
+    // Function to get the syndrome of the group of n carrier bytes at group; end is the end of the buffer
+    unsigned syndrome(const char* group, const char* end) const {
+        unsigned result = 0;
+        size_t chunk = 0;
+        for (; (chunk + 1) * 8 <= n; ++chunk) {
+            result ^= chunkSyndromes[chunk][lsbMask(group + chunk * 8)];
+        }
+        size_t rest = n - chunk * 8;
+        const char* tail = group + chunk * 8;
+        unsigned mask;
+        if (tail + 8 <= end) {
+            mask = lsbMask(tail) & ((1u << rest) - 1);
+        } else {
+            mask = 0;
+            for (size_t j = 0; j < rest; ++j) {
+                mask |= (tail[j] & 1u) << j;
+            }
+        }
+        return result ^ chunkSyndromes[chunk][mask];
+    }
+
+    // Function to embed the next message bits into groups; length is a multiple of n.
+    // The blocks of the file (the data starts at offset) whose bytes changed are added to dirty.
+    void embed(char* data, size_t length, BitReader& bits, off_t offset, DirtyRanges& dirty) const {
+        const char* end = data + length;
+        size_t modified = 0;
+        size_t dirtyEnd = dirty.ranges.empty() ? 0 : dirty.ranges.back().second;
+        for (char* group = data; group < end; group += n) {
+            // Without branches on the syndrome, which is as good as random: position 0 changes nothing
+            unsigned position = syndrome(group, end) ^ bits.next(k);
+            unsigned flip = position != 0;
+            size_t changed = group - data + position - flip;
+            data[changed] ^= static_cast<char>(flip);
+            modified += flip;
+            if (flip && changed >= dirtyEnd) { // once per block
+                dirty.addBlockOf(changed, length, offset);
+                dirtyEnd = dirty.ranges.back().second;
+            }
+        }
+        dirty.modifiedBytes += modified;
+    }
+
+    // Function to pass the bits carried by the groups to bits; length is a multiple of n.
+    // Returns true as soon as the end of message marker was read.
+    bool extract(const char* data, size_t length, BitWriter& bits) const {
+        const char* end = data + length;
+        for (const char* group = data; group < end; group += n) {
+            unsigned message = syndrome(group, end);
+            for (unsigned j = k; j-- > 0;) {
+                if (bits.push((message >> j) & 1)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    explicit HammingCode(unsigned bits) : k(bits), n((size_t(1) << bits) - 1) {
+        for (size_t chunk = 0; chunk < std::size(chunkSyndromes); ++chunk) {
+            for (unsigned mask = 0; mask < 256; ++mask) {
+                unsigned syndrome = 0;
+                for (unsigned j = 0; j < 8; ++j) {
+                    if (mask & (1u << j)) {
+                        syndrome ^= chunk * 8 + j + 1;
+                    }
+                }
+                chunkSyndromes[chunk][mask] = static_cast<uint8_t>(syndrome);
+            }
+        }
+    }
+
+    // Function to gather the LSBs of 8 bytes into one byte, bit j from byte j
+    static unsigned lsbMask(const char* bytes) {
+        uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        return ((word & 0x0101010101010101ull) * 0x0102040810204080ull) >> 56;
+    }
+
+    unsigned k;
+    size_t n;
+    uint8_t chunkSyndromes[32][256]; // syndrome of chunk c of a group by the LSBs of its bytes
+};
+
+// Bands from this size up are embedded by several threads
+const size_t parallelBandSize = 1 << 20;
+
+// Function to embed the next message bits into a band of independent units of unitBytes carrier bytes
+// and unitBits message bits each (the last one may be shorter) with embed(data, length, bits, offset, dirty).
+// Large bands are split among threads at unit boundaries.
+template <typename Embed>
+void embedUnitsInParallel(char* data, size_t length, size_t unitBytes, size_t unitBits, BitReader& bits, off_t offset,
+                          DirtyRanges& dirty, Embed&& embed) {
+    size_t units = (length + unitBytes - 1) / unitBytes;
+    size_t threadCount = length < parallelBandSize ? 1 : std::min<size_t>(units, std::max(1u, std::thread::hardware_concurrency()));
+    if (threadCount <= 1) {
+        embed(data, length, bits, offset, dirty);
+        return;
+    }
+    size_t start = bits.position();
+    std::vector<DirtyRanges> parts(threadCount);
+    std::vector<std::jthread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        size_t first = units * i / threadCount, last = units * (i + 1) / threadCount;
+        threads.emplace_back([&, i, first, last]() {
+            BitReader part = bits;
+            part.seek(start + first * unitBits);
+            size_t partOffset = first * unitBytes;
+            embed(data + partOffset, std::min(last * unitBytes, length) - partOffset, part, offset + partOffset, parts[i]);
+        });
+    }
+    for (std::jthread& thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        dirty.append(parts[i], units * i / threadCount * unitBytes);
+    }
+    bits.seek(start + length / unitBytes * unitBits + length % unitBytes * unitBits / unitBytes);
+}
+
+// Function to embed the next message bits into a band with the Hamming code; length is a multiple of n.
+// Returns the number of message bits embedded.
+size_t embedBandHamming(const HammingCode& code, char* data, size_t length, BitReader& bits, off_t offset, DirtyRanges& dirty) {
+    STATS_TIMER(Embed);
+    size_t start = bits.position();
+    size_t modifiedBefore = dirty.modifiedBytes;
+    embedUnitsInParallel(data, length, code.groupSize(), code.bits(), bits, offset, dirty,
+                         [&](char* part, size_t partLength, BitReader& partBits, off_t partOffset, DirtyRanges& partDirty) {
+                             code.embed(part, partLength, partBits, partOffset, partDirty);
+                         });
+    size_t embedded = std::min(length / code.groupSize() * code.bits(), bits.size() - std::min(start, bits.size()));
+    STATS_ADD(BitsEmbedded, embedded);
+    STATS_ADD(CarrierBytesModified, dirty.modifiedBytes - modifiedBefore);
+    return embedded;
+}
+
+// Function to pass the bits carried by a band to bits with the Hamming code; length is a multiple of n.
+// Returns true as soon as the end of message marker was read.
+bool collectBandHamming(const HammingCode& code, const char* data, size_t length, BitWriter& bits) {
+    STATS_TIMER(Extract);
+    STATS_ADD(BitsExtracted, length / code.groupSize() * code.bits());
+    return code.extract(data, length, bits);
+}
+
+// Function to get the code of --embedding hamming<k>, nullptr for plain LSB embedding
+const HammingCode* selectedHammingCode() {
+    const EmbeddingOptions& embedding = embeddingOptions();
+    return embedding.mode == "hamming" ? &HammingCode::get(embedding.hammingBits) : nullptr;
+}
+
+// Function to refuse an embedding mode other than plain LSB where only that is implemented
+void requireLSBEmbedding(const char* where) {
+    if (embeddingOptions().mode != "lsb") {
+        throw std::runtime_error("--embedding " + embeddingOptions().mode + " is not supported " + where + ".");
+    }
+}
@@ -0,0 +1,351 @@
+#include <mutex>
+#include <unordered_map>
+#include <sys/file.h> // flock
+#include <sys/mman.h>
+
+// Persistent cache of image information for --cache <file>, so --info and --check over a tree that
+// mostly did not change cost one statx and a hash lookup per unchanged file instead of an open and read.
+// Entries are keyed by (device, inode, size, modification time); an entry is only used when all four
+// still match, so a file that was rewritten or touched is read again and gets a new entry.
+// The file is a header followed by fixed size records that are only ever appended. It is memory mapped
+// and indexed once when the run starts; the records of files read during the run are appended together
+// at the end (by --serve after every connection), under flock so concurrent runs do not interleave. Records carry a checksum, so a record
+// torn by a crash is skipped. Once most records are stale the file is rewritten with the live ones.
+
+struct MetadataCacheKey {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t modificationSeconds;
+    int64_t modificationNanoseconds;
+
+    bool operator==(const MetadataCacheKey&) const = default;
+};
+
+// Identifies a file whatever its content: records are indexed by it, so a newer record of a file
+// replaces the older one in the index and the older one counts as stale
+struct MetadataCacheFileId {
+    uint64_t device;
+    uint64_t inode;
+
+    bool operator==(const MetadataCacheFileId&) const = default;
+};
+
+struct MetadataCacheFileIdHash {
+    size_t operator()(const MetadataCacheFileId& id) const {
+        uint64_t hash = id.inode * 0x9E3779B97F4A7C15ull ^ id.device;
+        return static_cast<size_t>(hash ^ (hash >> 29));
+    }
+};
+
+// One entry of the cache file, in the byte order of the machine that wrote it
+struct MetadataCacheRecord {
+    MetadataCacheKey key;
+    uint64_t rowStride;
+    uint64_t headerChunks;
+    uint64_t carrierSamples;
+    uint64_t pixels;
+    uint32_t width;
+    uint32_t height;
+    uint16_t bitsPerPixel;
+    uint16_t bitDepth;
+    uint8_t format;    // index into metadataCacheFormats
+    uint8_t colorType; // index into metadataCacheColorTypes
+    uint8_t interlaced;
+    uint8_t reserved;
+    uint64_t checksum; // of the bytes before it
+};
+
+static_assert(sizeof(MetadataCacheRecord) == 96, "the record layout is part of the file format");
+
+const char metadataCacheMagic[8] = {'S', 'T', 'E', 'G', 'C', 'A', 'C', 'H'};
+const uint32_t metadataCacheVersion = 2; // 2: headerChunks instead of the chunks of the whole file
+const char* const metadataCacheFormats[] = {"bmp", "png"};
+const char* const metadataCacheColorTypes[] = {"BGR", "BGRA", "gray", "RGB", "palette", "gray+alpha", "RGBA"};
+
+struct MetadataCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+};
+
+// Function to get the checksum of a record (FNV-1a over everything but the checksum)
+uint64_t metadataCacheChecksum(const MetadataCacheRecord& record) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&record);
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < offsetof(MetadataCacheRecord, checksum); ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Function to get the position of text in names, or -1
+int metadataCacheIndexOf(const char* const* names, size_t count, const std::string& text) {
+    for (size_t i = 0; i < count; ++i) {
+        if (text == names[i]) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+class MetadataCache {
+public:
+    ~MetadataCache() {
+        try {
+            flush();
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Could not update the metadata cache: " << e.what() << std::endl;
+        }
+        if (mapping != MAP_FAILED) {
+            munmap(mapping, mappingSize);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    // Function to open the cache file at path, creating it if needed, and index its records
+    void open(const std::string& cachePath) {
+        path = cachePath;
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open the metadata cache " + path + ": " + strerror(errno));
+        }
+        struct stat fileInfo{};
+        if (fstat(fd, &fileInfo) != 0) {
+            throw std::runtime_error(strerror(errno));
+        }
+        mappingSize = static_cast<size_t>(fileInfo.st_size);
+        if (mappingSize < sizeof(MetadataCacheHeader)) {
+            return; // new, or still empty: the header is written with the first records
+        }
+        mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Could not map the metadata cache " + path + ": " + strerror(errno));
+        }
+        const char* data = static_cast<const char*>(mapping);
+        MetadataCacheHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, metadataCacheMagic, sizeof(header.magic)) != 0 ||
+            header.version != metadataCacheVersion || header.recordSize != sizeof(MetadataCacheRecord)) {
+            incompatible = true; // rewritten by the next flush
+            return;
+        }
+        for (size_t offset = sizeof(header); offset + sizeof(MetadataCacheRecord) <= mappingSize; offset += sizeof(MetadataCacheRecord)) {
+            const MetadataCacheRecord* record = reinterpret_cast<const MetadataCacheRecord*>(data + offset);
+            if (record->checksum == metadataCacheChecksum(*record)) {
+                index[{record->key.device, record->key.inode}] = record; // a later record of the same file wins
+                ++storedRecords;
+            }
+        }
+    }
+
+    // Function to cache in memory only, for --serve without --cache
+    void openInMemory() {
+        inMemory = true;
+    }
+
+    bool enabled() const { return inMemory || !path.empty(); }
+
+    // Function to find the image information of a file with status; false if it is not cached
+    bool find(const FileStatus& status, ImageInfo& image) {
+        MetadataCacheKey key = keyOf(status);
+        auto it = index.find({key.device, key.inode});
+        if (it != index.end() && it->second->key == key) {
+            return toImageInfo(*it->second, image);
+        }
+        std::lock_guard lock(mutex); // added during this run, e.g. by an earlier request to --serve
+        auto recent = added.find({key.device, key.inode});
+        return recent != added.end() && recent->second.key == key && toImageInfo(recent->second, image);
+    }
+
+    // Function to add the image information of a file with status; written to the file by flush
+    void add(const FileStatus& status, const ImageInfo& image) {
+        MetadataCacheRecord record{};
+        record.key = keyOf(status);
+        int format = metadataCacheIndexOf(metadataCacheFormats, std::size(metadataCacheFormats), image.format);
+        int colorType = metadataCacheIndexOf(metadataCacheColorTypes, std::size(metadataCacheColorTypes), image.colorType);
+        if (format < 0 || colorType < 0) {
+            return;
+        }
+        record.rowStride = image.rowStride;
+        record.headerChunks = image.headerChunks;
+        record.carrierSamples = image.carrierSamples;
+        record.pixels = image.pixels;
+        record.width = image.width;
+        record.height = image.height;
+        record.bitsPerPixel = image.bitsPerPixel;
+        record.bitDepth = image.bitDepth;
+        record.format = static_cast<uint8_t>(format);
+        record.colorType = static_cast<uint8_t>(colorType);
+        record.interlaced = image.interlaced;
+        record.checksum = metadataCacheChecksum(record);
+        std::lock_guard lock(mutex);
+        if (fd >= 0) { // an in-memory cache has no file to flush the record to
+            pending.push_back(record);
+        }
+        added[{record.key.device, record.key.inode}] = record;
+    }
+
+    // Function to append the records added since the last flush to the cache file
+    void flush() {
+        std::lock_guard lock(mutex);
+        if (fd < 0 || pending.empty()) {
+            return;
+        }
+        bool compact = incompatible || (storedRecords > 4096 && storedRecords > 2 * (index.size() + added.size()));
+        if (flock(fd, LOCK_EX) != 0) {
+            throw std::runtime_error(strerror(errno));
+        }
+        try {
+            if (compact) {
+                storedRecords = rewrite();
+            } else {
+                append();
+                storedRecords += pending.size();
+            }
+        } catch (...) {
+            flock(fd, LOCK_UN);
+            throw;
+        }
+        flock(fd, LOCK_UN);
+        pending.clear();
+        if (compact) { // later records go to the new file; the mapping keeps the old one readable
+            close(fd);
+            fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+            if (fd < 0) {
+                throw std::runtime_error(strerror(errno));
+            }
+            incompatible = false;
+        }
+    }
+
+private:
+    static MetadataCacheKey keyOf(const FileStatus& status) {
+        return {static_cast<uint64_t>(status.device), static_cast<uint64_t>(status.inode), static_cast<uint64_t>(status.size),
+                static_cast<int64_t>(status.modificationTime.tv_sec), static_cast<int64_t>(status.modificationTime.tv_nsec)};
+    }
+
+    // Function to add the pending records at the end of the file, writing the header first if it has none
+    void append() {
+        struct stat fileInfo{};
+        if (fstat(fd, &fileInfo) != 0) {
+            throw std::runtime_error(strerror(errno));
+        }
+        off_t end = fileInfo.st_size;
+        if (end < static_cast<off_t>(sizeof(MetadataCacheHeader))) {
+            writeHeader(fd);
+            end = sizeof(MetadataCacheHeader);
+        }
+        // A record torn by a crash leaves the end between two records; start at the next whole one
+        end -= (end - static_cast<off_t>(sizeof(MetadataCacheHeader))) % static_cast<off_t>(sizeof(MetadataCacheRecord));
+        writeAll(fd, pending.data(), pending.size() * sizeof(MetadataCacheRecord), end);
+    }
+
+    // Function to replace the file by one holding the latest record of every file; returns the record count
+    size_t rewrite() {
+        std::string temporaryPath = path + ".tmp";
+        int out = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out < 0) {
+            throw std::runtime_error(strerror(errno));
+        }
+        std::vector<MetadataCacheRecord> live;
+        try {
+            writeHeader(out);
+            live.reserve(index.size() + added.size());
+            if (!incompatible) {
+                for (const auto& [id, record] : index) {
+                    if (!added.contains(id)) {
+                        live.push_back(*record);
+                    }
+                }
+            }
+            for (const auto& [id, record] : added) {
+                live.push_back(record);
+            }
+            writeAll(out, live.data(), live.size() * sizeof(MetadataCacheRecord), sizeof(MetadataCacheHeader));
+        } catch (...) {
+            close(out);
+            unlink(temporaryPath.c_str());
+            throw;
+        }
+        close(out);
+        if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error(strerror(errno));
+        }
+        return live.size();
+    }
+
+    // Function to get the image information of a record; false if the record names an unknown format
+    static bool toImageInfo(const MetadataCacheRecord& record, ImageInfo& image) {
+        if (record.format >= std::size(metadataCacheFormats) || record.colorType >= std::size(metadataCacheColorTypes)) {
+            return false;
+        }
+        image.format = metadataCacheFormats[record.format];
+        image.width = record.width;
+        image.height = record.height;
+        image.bitsPerPixel = record.bitsPerPixel;
+        image.bitDepth = record.bitDepth;
+        image.colorType = metadataCacheColorTypes[record.colorType];
+        image.interlaced = record.interlaced != 0;
+        image.rowStride = record.rowStride;
+        image.headerChunks = record.headerChunks;
+        image.carrierSamples = record.carrierSamples;
+        computeImageCapacity(image, record.pixels);
+        return true;
+    }
+
+    static void writeHeader(int fileDescriptor) {
+        MetadataCacheHeader header{};
+        std::memcpy(header.magic, metadataCacheMagic, sizeof(header.magic));
+        header.version = metadataCacheVersion;
+        header.recordSize = sizeof(MetadataCacheRecord);
+        writeAll(fileDescriptor, &header, sizeof(header), 0);
+    }
+
+    static void writeAll(int fileDescriptor, const void* data, size_t size, off_t offset) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t count = pwrite(fileDescriptor, bytes, size, offset);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                throw std::runtime_error(strerror(errno));
+            }
+            bytes += count;
+            size -= count;
+            offset += count;
+        }
+    }
+
+    std::string path;
+    bool inMemory = false;
+    int fd = -1;
+    void* mapping = MAP_FAILED;
+    size_t mappingSize = 0;
+    bool incompatible = false;
+    size_t storedRecords = 0; // valid records in the file, stale ones included
+    std::unordered_map<MetadataCacheFileId, const MetadataCacheRecord*, MetadataCacheFileIdHash> index; // latest record of each file
+    std::mutex mutex; // guards added and pending
+    std::unordered_map<MetadataCacheFileId, MetadataCacheRecord, MetadataCacheFileIdHash> added; // records added during the run
+    std::vector<MetadataCacheRecord> pending; // added records not written yet
+};
+
+MetadataCache metadataCache;
+
+// Function to get the image information of a file with status, from the cache when it has the file
+ImageInfo readCachedImageInfo(const std::string& filename, const FileStatus& status) {
+    ImageInfo image;
+    if (metadataCache.enabled() && metadataCache.find(status, image)) {
+        STATS_ADD(CacheHits, 1);
+        return image;
+    }
+    image = readImageInfo(filename, status.size);
+    if (metadataCache.enabled()) {
+        STATS_ADD(CacheMisses, 1);
+        metadataCache.add(status, image);
+    }
+    return image;
+}
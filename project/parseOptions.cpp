@@ -0,0 +1,143 @@
+#include <array>
+
+// How message bits are embedded and extracted. --connect sends these along with every request, so a
+// --serve worker carries the request out with the client's settings instead of its own.
+struct EmbeddingOptions {
+    std::string mode = "lsb"; // into BMP carriers: lsb, matching, hamming or stc (--embedding)
+    unsigned hammingBits = 3; // message bits per group of --embedding hamming<k>
+    unsigned stcHeight = 7;   // constraint height of --embedding stc<h>
+    unsigned stcWidth = 4;    // carrier bytes per message bit with --embedding stc (--stc-width)
+    bool checksums = false;   // a checksum after every block of the message (--checksums)
+    uint64_t seed = 0;        // random source of --embedding matching (--seed), a new one every run when 0
+};
+
+// Options that may appear anywhere on the command line, next to the flag and its arguments
+struct Options {
+    size_t memoryBudget = 64 * 1024 * 1024; // bytes of carrier data held in memory at once
+    std::string ioBackend = "auto";          // batch I/O: auto, uring or pread
+    unsigned queueDepth = 64;                // files in flight during a batch run
+    bool stats = false;                      // print phase times and counters at the end
+    bool trace = false;                      // record a trace of the run into tracePath
+    std::string tracePath;
+    bool fsync = false;                      // flush modified carriers to disk before reporting success
+    std::string format = "text";             // --info output: text, json or csv
+    std::string cachePath;                   // metadata cache for --info and --check, none when empty
+    std::string servePath;                   // socket to serve requests on (--serve)
+    std::string connectPath;                 // socket of a server to send the flag to (--connect)
+    EmbeddingOptions embedding;              // --embedding, --stc-width, --checksums and --seed
+    std::array<unsigned, 3> pipelineThreads{}; // reader, compute and writer threads of a batch run (--pipeline), none when 0
+};
+
+Options options;
+
+// Embedding options of the request a --serve worker is carrying out, nullptr on every other thread
+thread_local const EmbeddingOptions* requestEmbedding = nullptr;
+
+// Function to get the embedding options in effect: those of the request being served, or the command line's
+const EmbeddingOptions& embeddingOptions() {
+    return requestEmbedding ? *requestEmbedding : options.embedding;
+}
+
+// Function to parse a size such as 4096, 512K, 64M or 2G
+size_t parseSize(const std::string& text) {
+    size_t end = 0;
+    unsigned long long value = std::stoull(text, &end);
+    std::string suffix = text.substr(end);
+    std::ranges::transform(suffix, suffix.begin(), ::toupper);
+    if (suffix == "K" || suffix == "KB") value <<= 10;
+    else if (suffix == "M" || suffix == "MB") value <<= 20;
+    else if (suffix == "G" || suffix == "GB") value <<= 30;
+    else if (!suffix.empty()) throw std::runtime_error("Invalid size: " + text);
+    return value;
+}
+
+// Function to parse the --pipeline thread counts, e.g. 2,4,2
+std::array<unsigned, 3> parsePipelineThreads(const std::string& text) {
+    std::array<unsigned, 3> threads{};
+    std::istringstream stream(text);
+    std::string count;
+    for (unsigned& stage : threads) {
+        if (!std::getline(stream, count, ',') || count.empty() || count.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::runtime_error("Invalid --pipeline thread counts: " + text + " (expected readers,compute,writers)");
+        }
+        stage = std::clamp<unsigned>(std::stoul(count), 1, 256);
+    }
+    if (std::getline(stream, count)) {
+        throw std::runtime_error("Invalid --pipeline thread counts: " + text + " (expected readers,compute,writers)");
+    }
+    return threads;
+}
+
+// Function to take the options out of the arguments.
+// The remaining arguments are moved to the front of argv and argc is updated,
+// so the flag handling in main only sees the flag and its own arguments.
+void parseOptions(int& argc, char* argv[]) {
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--memory-budget" && i + 1 < argc) {
+            options.memoryBudget = std::max<size_t>(1, parseSize(argv[++i]));
+        } else if (argument == "--io" && i + 1 < argc) {
+            options.ioBackend = argv[++i];
+            if (options.ioBackend != "auto" && options.ioBackend != "uring" && options.ioBackend != "pread") {
+                throw std::runtime_error("Unknown I/O backend: " + options.ioBackend);
+            }
+        } else if (argument == "--queue-depth" && i + 1 < argc) {
+            options.queueDepth = std::clamp<unsigned>(std::stoul(argv[++i]), 1, 4096);
+        } else if (argument == "--stats") {
+            options.stats = true;
+        } else if (argument == "--trace" && i + 1 < argc) {
+            options.trace = true;
+            options.tracePath = argv[++i];
+        } else if (argument == "--fsync") {
+            options.fsync = true;
+        } else if (argument == "--format" && i + 1 < argc) {
+            options.format = argv[++i];
+            if (options.format != "text" && options.format != "json" && options.format != "csv") {
+                throw std::runtime_error("Unknown output format: " + options.format);
+            }
+        } else if (argument == "--cache" && i + 1 < argc) {
+            options.cachePath = argv[++i];
+        } else if (argument == "--serve" && i + 1 < argc) {
+            options.servePath = argv[++i];
+        } else if (argument == "--connect" && i + 1 < argc) {
+            options.connectPath = argv[++i];
+        } else if (argument == "--embedding" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode.starts_with("hamming")) {
+                std::string bits = mode.substr(7);
+                if (!bits.empty()) {
+                    if (bits.find_first_not_of("0123456789") != std::string::npos || std::stoul(bits) < 2 || std::stoul(bits) > 8) {
+                        throw std::runtime_error("Invalid Hamming code: " + mode + " (hamming2 to hamming8)");
+                    }
+                    options.embedding.hammingBits = std::stoul(bits);
+                }
+                options.embedding.mode = "hamming";
+            } else if (mode.starts_with("stc")) {
+                std::string height = mode.substr(3);
+                if (!height.empty()) {
+                    if (height.find_first_not_of("0123456789") != std::string::npos || std::stoul(height) < 4 || std::stoul(height) > 12) {
+                        throw std::runtime_error("Invalid constraint height: " + mode + " (stc4 to stc12)");
+                    }
+                    options.embedding.stcHeight = std::stoul(height);
+                }
+                options.embedding.mode = "stc";
+            } else if (mode == "lsb" || mode == "matching") {
+                options.embedding.mode = mode;
+            } else {
+                throw std::runtime_error("Unknown embedding mode: " + mode);
+            }
+        } else if (argument == "--stc-width" && i + 1 < argc) {
+            options.embedding.stcWidth = std::clamp<unsigned>(std::stoul(argv[++i]), 2, 32);
+        } else if (argument == "--checksums") {
+            options.embedding.checksums = true;
+        } else if (argument == "--seed" && i + 1 < argc) {
+            options.embedding.seed = std::stoull(argv[++i], nullptr, 0);
+        } else if (argument == "--pipeline" && i + 1 < argc) {
+            options.pipelineThreads = parsePipelineThreads(argv[++i]);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+}
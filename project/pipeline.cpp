@@ -0,0 +1,297 @@
+#include <latch>
+#include <map>
+#include <mutex>
+#include <optional>
+
+// Batch runs as a pipeline of three thread stages, selected with --pipeline <readers>,<compute>,<writers>:
+// readers open the BMP files and read their pixel data in bands, compute threads embed the message into
+// a band (or pack the LSBs of a band into bytes when extracting), and writers write the bands back (or
+// put the extracted bytes of a file together in order). The stages are connected by bounded lock-free
+// queues of options.queueDepth bands each, so a stage that falls behind makes the one before it wait
+// instead of letting bands pile up in memory. With --stats every stage reports how its threads spent
+// their time, to tune the thread counts of the stages against each other.
+// Bands of one file are independent: each is embedded from its own bit position of the message, so any
+// compute thread can take any band. PNG files need the whole zlib stream and are handled by a reader, as
+// are BMP files with a coded --embedding mode (hamming<k> or stc<h>).
+
+// A file in the pipeline; shared by the bands of the file in all stages
+struct PipelineFile {
+    BatchFile* result = nullptr;
+    int fd = -1;
+    uint32_t dataOffset = 0;
+    // Bands still to finish plus one while the reader is still adding bands; the stage that takes it
+    // to zero finishes the file
+    std::atomic<size_t> outstanding{1};
+    std::atomic<bool> stop{false}; // the file failed, or the end of message marker was found
+
+    std::mutex mutex; // guards the fields below
+    std::string error;
+    size_t modifiedBytes = 0;
+    std::optional<BitWriter> extracted;
+    size_t nextBand = 0;                      // next band to add to extracted
+    std::map<size_t, PooledBuffer> readyBands; // packed bands that arrived before nextBand
+};
+
+struct PipelineBand {
+    PipelineFile* file = nullptr;
+    size_t index = 0; // position of the band in the file
+    size_t start = 0; // offset of the band in the pixel data
+    size_t length = 0;
+    PooledBuffer data;
+    DirtyRanges dirty; // blocks to write back after embedding
+};
+
+// How the threads of one stage spent their time
+struct PipelineStageStats {
+    const char* name;
+    unsigned threads = 0;
+    std::atomic<uint64_t> bands{0};
+    std::atomic<int64_t> totalNanoseconds{0};
+    std::atomic<int64_t> inputWaitNanoseconds{0};
+    std::atomic<int64_t> outputWaitNanoseconds{0};
+
+    void add(std::chrono::nanoseconds total, std::chrono::nanoseconds inputWait, std::chrono::nanoseconds outputWait) {
+        totalNanoseconds += total.count();
+        inputWaitNanoseconds += inputWait.count();
+        outputWaitNanoseconds += outputWait.count();
+    }
+
+    void print() const {
+        double total = std::max<double>(1, totalNanoseconds.load());
+        double inputWait = inputWaitNanoseconds.load() / total * 100;
+        double outputWait = outputWaitNanoseconds.load() / total * 100;
+        std::cerr << "  " << std::left << std::setw(8) << name << std::right << std::setw(4) << threads << " threads"
+                  << std::setw(10) << bands.load() << " bands" << std::fixed << std::setprecision(1)
+                  << std::setw(8) << 100 - inputWait - outputWait << "% busy" << std::setw(8) << inputWait
+                  << "% waiting for input" << std::setw(8) << outputWait << "% waiting for output" << std::endl;
+    }
+};
+
+// Function to embed message into (message != nullptr) or extract a message from every file with the
+// threads of options.pipelineThreads. Results are printed in the order of filenames. Returns false if any file failed.
+bool runPipelineBatch(const std::vector<std::string>& filenames, const std::string* message) {
+    std::vector<BatchFile> results(filenames.size());
+    std::vector<PipelineFile> files(filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        results[i].filename = filenames[i];
+        files[i].result = &results[i];
+        if (options.trace) {
+            results[i].traceId = tracer.fileId(filenames[i]);
+        }
+    }
+    BoundedQueue<PipelineBand*> computeQueue(options.queueDepth);
+    BoundedQueue<PipelineBand*> writeQueue(options.queueDepth);
+    PipelineStageStats readStats{"read", options.pipelineThreads[0]};
+    PipelineStageStats computeStats{"compute", options.pipelineThreads[1]};
+    PipelineStageStats writeStats{"write", options.pipelineThreads[2]};
+    std::atomic<size_t> nextFile{0};
+    std::atomic<unsigned> readersRunning{readStats.threads};
+    std::atomic<unsigned> computeRunning{computeStats.threads};
+    // Bands in flight: both queues full and one in every thread; they share the memory budget
+    size_t bandsInFlight = 2 * options.queueDepth + readStats.threads + computeStats.threads + writeStats.threads;
+    size_t bandBudget = std::max<size_t>(1, options.memoryBudget / bandsInFlight);
+    BitReader messageBits = message ? BitReader(*message) : BitReader(); // copied for every band
+
+    auto fail = [](PipelineFile& file, const std::string& error) {
+        std::lock_guard lock(file.mutex);
+        if (file.error.empty()) {
+            file.error = error;
+        }
+        file.stop = true;
+    };
+    // Function to finish a file once nothing of it is in flight any more
+    auto release = [&](PipelineFile& file) {
+        if (file.outstanding.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        std::lock_guard lock(file.mutex);
+        if (file.fd >= 0) {
+            try {
+                if (message && file.error.empty() && file.modifiedBytes > 0) {
+                    syncFile(file.fd);
+                }
+            } catch (const std::exception& e) {
+                file.error = e.what();
+            }
+            STATS_ADD(Syscalls, 1);
+            close(file.fd);
+            file.fd = -1;
+        }
+        if (file.extracted) {
+            try {
+                file.extracted->finish();
+            } catch (const std::exception& e) { // a damaged block (--checksums)
+                if (file.error.empty()) {
+                    file.error = e.what();
+                }
+            }
+        }
+        file.readyBands.clear();
+        file.result->error = file.error;
+        file.result->modifiedBytes = file.modifiedBytes;
+    };
+
+    auto read = [&]() {
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::nanoseconds outputWait{0};
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            PipelineFile& file = files[i];
+            BatchFile& result = *file.result;
+            TRACE_FILE_ID(result.traceId);
+            try {
+                std::string extension = fileExtensionOf(result.filename);
+                if (extension == "png" || (extension == "bmp" && codedEmbedding())) {
+                    if (message) {
+                        file.modifiedBytes = extension == "png" ? writeMessageToPNG(result.filename, *message)
+                                                                : writeMessageToBMP(result.filename, *message);
+                    } else {
+                        result.message = extension == "png" ? readMessageFromPNG(result.filename) : readMessageFromBMP(result.filename);
+                    }
+                } else if (extension != "bmp") {
+                    throw std::runtime_error("Unsupported file format. Only .bmp and .png are supported.");
+                } else {
+                    file.fd = openFile(result.filename, message ? O_RDWR : O_RDONLY);
+                    if (file.fd < 0) {
+                        throw std::runtime_error(strerror(errno));
+                    }
+                    char header[bmpHeaderSize];
+                    readAt(file.fd, header, bmpHeaderSize, 0);
+                    size_t pixelBytes, bandSize;
+                    {
+                        STATS_TIMER(HeaderParse);
+                        uint32_t width, height;
+                        uint16_t bitsPerPixel;
+                        file.dataOffset = parseBMPHeader(header, width, height, bitsPerPixel);
+                        struct stat fileInfo{};
+                        STATS_ADD(Syscalls, 1);
+                        if (fstat(file.fd, &fileInfo) != 0 || fileInfo.st_size <= file.dataOffset) {
+                            throw std::runtime_error("Could not get file size.");
+                        }
+                        pixelBytes = fileInfo.st_size - file.dataOffset;
+                        if (message) {
+                            if (payloadLength(message->length()) > pixelBytes / (bitsPerPixel / 8) / 8) {
+                                throw std::runtime_error("Message is too long to fit in the image.");
+                            }
+                            pixelBytes = std::min(pixelBytes, messageBits.size()); // only the bytes that get a bit
+                        } else {
+                            file.extracted.emplace(result.message);
+                        }
+                        // Whole rows, an even number of them so packed bands end on a byte
+                        size_t stride = bmpRowStride(width, bitsPerPixel);
+                        size_t rows = std::max<size_t>(2, bandBudget / stride / 2 * 2);
+                        bandSize = std::min(rows * stride, pixelBytes);
+                    }
+                    for (size_t index = 0, bandStart = 0; bandStart < pixelBytes && !file.stop; ++index, bandStart += bandSize) {
+                        auto band = std::make_unique<PipelineBand>();
+                        band->file = &file;
+                        band->index = index;
+                        band->start = bandStart;
+                        band->length = std::min(bandSize, pixelBytes - bandStart);
+                        band->data = BufferPool::local().acquire(band->length);
+                        readAt(file.fd, band->data.data(), band->length, file.dataOffset + bandStart);
+                        file.outstanding.fetch_add(1, std::memory_order_relaxed);
+                        ++readStats.bands;
+                        computeQueue.push(band.release(), outputWait);
+                    }
+                }
+            } catch (const std::exception& e) {
+                fail(file, e.what());
+            }
+            release(file); // the reader's own share
+        }
+        if (--readersRunning == 0) {
+            computeQueue.close();
+        }
+        readStats.add(std::chrono::steady_clock::now() - start, {}, outputWait);
+    };
+
+    auto compute = [&]() {
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::nanoseconds inputWait{0}, outputWait{0};
+        PipelineBand* band;
+        while (computeQueue.pop(band, inputWait)) {
+            PipelineFile& file = *band->file;
+            TRACE_FILE_ID(file.result->traceId);
+            if (!file.stop) {
+                if (message) {
+                    BitReader bits = messageBits;
+                    bits.seek(band->start);
+                    embedBandBits(band->data.data(), band->length, bits, file.dataOffset + band->start, band->dirty);
+                } else {
+                    band->length = packBandBits(band->data.data(), band->length);
+                }
+            }
+            ++computeStats.bands;
+            writeQueue.push(band, outputWait);
+        }
+        if (--computeRunning == 0) {
+            writeQueue.close();
+        }
+        computeStats.add(std::chrono::steady_clock::now() - start, inputWait, outputWait);
+    };
+
+    auto write = [&]() {
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::nanoseconds inputWait{0};
+        PipelineBand* pointer;
+        while (writeQueue.pop(pointer, inputWait)) {
+            std::unique_ptr<PipelineBand> band(pointer);
+            PipelineFile& file = *band->file;
+            TRACE_FILE_ID(file.result->traceId);
+            try {
+                if (file.stop) {
+                    // failed, or the message already ended in an earlier band
+                } else if (message) {
+                    writeDirtyRanges(file.fd, band->data.data(), band->dirty, file.dataOffset + band->start);
+                    std::lock_guard lock(file.mutex);
+                    file.modifiedBytes += band->dirty.modifiedBytes;
+                } else {
+                    band->data.shrink(band->length);
+                    std::lock_guard lock(file.mutex);
+                    file.readyBands.emplace(band->index, std::move(band->data));
+                    // Add the bands that are now in order; the marker ends the message
+                    auto next = file.readyBands.begin();
+                    while (next != file.readyBands.end() && next->first == file.nextBand) {
+                        for (size_t i = 0; i < next->second.size() && !file.stop; ++i) {
+                            file.stop = file.extracted->pushByte(static_cast<unsigned char>(next->second[i]));
+                        }
+                        next = file.readyBands.erase(next);
+                        ++file.nextBand;
+                    }
+                }
+            } catch (const std::exception& e) {
+                fail(file, e.what());
+            }
+            ++writeStats.bands;
+            band.reset(); // back to the pool of its reader before the file may finish
+            release(file);
+        }
+        writeStats.add(std::chrono::steady_clock::now() - start, inputWait, {});
+    };
+
+    // Threads wait for each other before they exit: a reader's buffer pool must outlive the bands it handed on
+    std::latch finished(readStats.threads + computeStats.threads + writeStats.threads);
+    std::vector<std::thread> threads;
+    auto launch = [&](unsigned count, auto stage) {
+        for (unsigned i = 0; i < count; ++i) {
+            threads.emplace_back([&finished, stage]() {
+                stage();
+                finished.arrive_and_wait();
+            });
+        }
+    };
+    launch(readStats.threads, read);
+    launch(computeStats.threads, compute);
+    launch(writeStats.threads, write);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    if (options.stats) {
+        std::cerr << "Pipeline:" << std::endl;
+        readStats.print();
+        computeStats.print();
+        writeStats.print();
+    }
+    return printBatchResults(results, message);
+}
@@ -0,0 +1,121 @@
+// Message carriers inside decoded PNG data.
+// Each layout has its own kernel so the per-byte loops stay free of layout checks:
+//  - 8 bit samples (grayscale, grayscale + alpha, RGB, RGBA): the LSB of every byte
+//  - 16 bit samples: samples are big endian, only the LSB of the low (second) byte is used
+//  - palette images: the LSB of the palette index, indices of an unpaired last entry are skipped
+//    (flipping their LSB would point past the end of the palette)
+enum class PNGCarrier { Samples8, Samples16, PaletteIndex };
+
+PNGCarrier pngCarrier(const PNGInfo& info) {
+    if (info.colorType == 3) return PNGCarrier::PaletteIndex;
+    if (info.bitDepth == 16) return PNGCarrier::Samples16;
+    return PNGCarrier::Samples8;
+}
+
+// Palette indices below this value come in pairs that differ only in the LSB
+int pairedPaletteEntries(const PNGInfo& info) {
+    return info.paletteEntries & ~1;
+}
+
+// Function to count the bytes of the image data that can carry one message bit
+size_t pngCarrierCapacity(const PNGInfo& info, const PooledBuffer& imageData) {
+    switch (pngCarrier(info)) {
+        case PNGCarrier::Samples8:
+            return imageData.size();
+        case PNGCarrier::Samples16:
+            return imageData.size() / 2;
+        case PNGCarrier::PaletteIndex: {
+            int paired = pairedPaletteEntries(info);
+            return std::ranges::count_if(imageData, [paired](char index) {
+                return static_cast<unsigned char>(index) < paired;
+            });
+        }
+    }
+    return 0;
+}
+
+// Function to embed bits into 8 bit samples; the embed kernels return the number of bytes that changed
+size_t embedBitsSamples8(char* data, BitReader& bits) {
+    size_t count = bits.remaining();
+    size_t modified = 0;
+    for (size_t i = 0; i < count; ++i) {
+        setCarrierBit(data[i], bits.next(), modified);
+    }
+    return modified;
+}
+
+// Function to embed bits into the low byte of 16 bit big endian samples
+size_t embedBitsSamples16(char* data, BitReader& bits) {
+    size_t count = bits.remaining();
+    size_t modified = 0;
+    for (size_t i = 0; i < count; ++i) {
+        setCarrierBit(data[2 * i + 1], bits.next(), modified);
+    }
+    return modified;
+}
+
+// Function to embed bits into palette indices, skipping indices that have no partner entry
+size_t embedBitsPaletteIndex(char* data, BitReader& bits, int pairedEntries) {
+    size_t modified = 0;
+    for (size_t j = 0; !bits.done(); ++j) {
+        if (static_cast<unsigned char>(data[j]) >= pairedEntries) {
+            continue;
+        }
+        setCarrierBit(data[j], bits.next(), modified);
+    }
+    return modified;
+}
+
+size_t embedBitsCarrier(const PNGInfo& info, PooledBuffer& imageData, BitReader& bits) {
+    switch (pngCarrier(info)) {
+        case PNGCarrier::Samples8:
+            return embedBitsSamples8(imageData.data(), bits);
+        case PNGCarrier::Samples16:
+            return embedBitsSamples16(imageData.data(), bits);
+        case PNGCarrier::PaletteIndex:
+            return embedBitsPaletteIndex(imageData.data(), bits, pairedPaletteEntries(info));
+    }
+    return 0;
+}
+
+// Function to embed bits into the carrier of the image data; the caller checks the capacity.
+// Returns the number of carrier bytes that changed.
+size_t embedBitsPNG(const PNGInfo& info, PooledBuffer& imageData, BitReader& bits) {
+    STATS_TIMER(Embed);
+    STATS_ADD(BitsEmbedded, bits.remaining());
+    size_t modified = embedBitsCarrier(info, imageData, bits);
+    STATS_ADD(CarrierBytesModified, modified);
+    return modified;
+}
+
+// Function to pass the carrier bits of one scanline to bits.
+// Returns true as soon as the end of message marker was read; the rest of the row is ignored.
+bool collectBitsPNG(const PNGInfo& info, const char* row, size_t length, BitWriter& bits) {
+    STATS_TIMER(Extract);
+    size_t pushed = 0; // bits passed on, for --stats
+    bool ended = false;
+    switch (pngCarrier(info)) {
+        case PNGCarrier::Samples8:
+            for (size_t i = 0; i < length && !ended; ++i, ++pushed) {
+                ended = bits.push(row[i] & 1);
+            }
+            break;
+        case PNGCarrier::Samples16:
+            for (size_t i = 1; i < length && !ended; i += 2, ++pushed) {
+                ended = bits.push(row[i] & 1);
+            }
+            break;
+        case PNGCarrier::PaletteIndex: {
+            int paired = pairedPaletteEntries(info);
+            for (size_t i = 0; i < length && !ended; ++i) {
+                if (static_cast<unsigned char>(row[i]) < paired) {
+                    ended = bits.push(row[i] & 1);
+                    ++pushed;
+                }
+            }
+            break;
+        }
+    }
+    STATS_ADD(BitsExtracted, pushed);
+    return ended;
+}
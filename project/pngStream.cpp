@@ -0,0 +1,433 @@
+#include <zlib.h> // inflate/deflate and crc32 for the PNG image data
+#include <limits> // std::numeric_limits
+
+// PNG image layout as described by the IHDR chunk.
+struct PNGInfo {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    unsigned char bitDepth = 0;
+    unsigned char colorType = 0;
+    unsigned char interlaceMethod = 0;
+    int channels = 0;   // samples per pixel
+    int filterUnit = 0; // bytes per complete pixel (at least 1), used by the Sub, Average and Paeth filters
+    size_t stride = 0;  // bytes per scanline without the leading filter type byte
+    int paletteEntries = 0; // number of PLTE entries, color type 3 only
+    std::vector<std::pair<std::string, std::string>> extraChunks; // chunks between IHDR and IDAT (PLTE, tRNS, gAMA, ...), kept for rewriting
+    std::vector<std::pair<std::string, std::string>> trailingChunks; // chunks between IDAT and IEND (tEXt, iTXt, eXIf, tIME, ...), kept for rewriting
+};
+
+// Function to read a 4 byte big endian number from a PNG stream
+uint32_t readBigEndian32(std::istream& file) {
+    uint32_t value = 0;
+    file.read(reinterpret_cast<char*>(&value), 4);
+    return __builtin_bswap32(value);
+}
+
+// Longest chunk the PNG specification allows
+const uint32_t maxPNGChunkLength = 0x7fffffff;
+
+// Function to get the offset of the end of a stream, -1 if the stream cannot tell; the position is kept
+std::streamoff streamEnd(std::istream& file) {
+    std::streampos position = file.tellg();
+    if (position == std::streampos(-1)) {
+        return -1;
+    }
+    file.seekg(0, std::ios::end);
+    std::streamoff end = file.tellg();
+    file.seekg(position);
+    return end;
+}
+
+// Function to check the length of the chunk whose data starts at the current position, against the
+// PNG limit and against the rest of the file (fileEnd, -1 when unknown), before anything is allocated for it
+void checkPNGChunkLength(std::istream& file, uint32_t length, std::streamoff fileEnd) {
+    if (length > maxPNGChunkLength) {
+        throw std::runtime_error("Invalid PNG chunk length.");
+    }
+    if (fileEnd >= 0 && std::streamoff(file.tellg()) + length > fileEnd) {
+        throw std::runtime_error("Truncated PNG file.");
+    }
+}
+
+// Function to read the data of a chunk, throwing if the file ends before it does
+void readPNGChunkData(std::istream& file, char* data, uint32_t length) {
+    file.read(data, length);
+    if (file.gcount() != static_cast<std::streamsize>(length)) {
+        throw std::runtime_error("Truncated PNG file.");
+    }
+}
+
+// Function to read the PNG signature and the IHDR chunk.
+// Leaves the stream positioned at the first chunk after IHDR.
+void readPNGHeader(std::istream& file, PNGInfo& info) {
+    STATS_TIMER(HeaderParse);
+    STATS_ADD(BytesRead, 33); // signature and IHDR chunk
+    // PNG Header (8 bytes): 89 50 4E 47 0D 0A 1A 0A
+    unsigned char header[8];
+    file.read(reinterpret_cast<char*>(header), 8);
+    if (!file || header[0] != 0x89 || header[1] != 0x50 || header[2] != 0x4E || header[3] != 0x47 ||
+        header[4] != 0x0D || header[5] != 0x0A || header[6] != 0x1A || header[7] != 0x0A) {
+        throw std::runtime_error("Not a valid PNG file.");
+    }
+
+    // IHDR has to be the first chunk: width, height, bit depth, color type, compression, filter, interlace
+    uint32_t length = readBigEndian32(file);
+    char type[4];
+    file.read(type, 4);
+    if (!file || std::string(type, 4) != "IHDR" || length != 13) {
+        throw std::runtime_error("PNG file does not start with an IHDR chunk.");
+    }
+    info.width = readBigEndian32(file);
+    info.height = readBigEndian32(file);
+    unsigned char fields[5];
+    file.read(reinterpret_cast<char*>(fields), 5);
+    if (!file) {
+        throw std::runtime_error("Truncated PNG file.");
+    }
+    file.seekg(4, std::ios::cur); // Skip CRC
+    info.bitDepth = fields[0];
+    info.colorType = fields[1];
+    info.interlaceMethod = fields[4];
+
+    // Samples per pixel for grayscale (0), RGB (2), palette (3), grayscale with alpha (4) and RGBA (6)
+    switch (info.colorType) {
+        case 0: info.channels = 1; break;
+        case 2: info.channels = 3; break;
+        case 3: info.channels = 1; break;
+        case 4: info.channels = 2; break;
+        case 6: info.channels = 4; break;
+        default: throw std::runtime_error("Unsupported PNG color type.");
+    }
+    if (info.bitDepth != 8 && (info.bitDepth != 16 || info.colorType == 3)) {
+        throw std::runtime_error("Unsupported PNG bit depth.  Must be 8 (or 16 for non-palette images).");
+    }
+    if (fields[2] != 0 || fields[3] != 0) {
+        throw std::runtime_error("Unsupported PNG compression or filter method.");
+    }
+    if (info.interlaceMethod > 1) {
+        throw std::runtime_error("Unsupported PNG interlace method.");
+    }
+
+    info.filterUnit = std::max(1, info.channels * info.bitDepth / 8);
+    info.stride = static_cast<size_t>(info.width) * info.channels * info.bitDepth / 8;
+}
+
+// One reduced image of the PNG data stream: the whole image, or one of the seven Adam7 passes
+struct PNGPass {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    size_t stride = 0; // bytes per scanline of this pass without the filter type byte
+};
+
+// Function to list the reduced images in data stream order.
+// Empty Adam7 passes (possible for images narrower or lower than 5 pixels) are left out,
+// they contribute no scanlines to the data stream.
+std::vector<PNGPass> pngPasses(const PNGInfo& info) {
+    if (info.interlaceMethod == 0) {
+        return {{info.width, info.height, info.stride}};
+    }
+    // Adam7: starting column, starting row, column step, row step
+    const uint32_t adam7[7][4] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4},
+                                  {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+    std::vector<PNGPass> passes;
+    for (const auto& [x0, y0, dx, dy] : adam7) {
+        PNGPass pass;
+        pass.width = info.width > x0 ? (info.width - x0 + dx - 1) / dx : 0;
+        pass.height = info.height > y0 ? (info.height - y0 + dy - 1) / dy : 0;
+        pass.stride = static_cast<size_t>(pass.width) * info.channels * info.bitDepth / 8;
+        if (pass.width > 0 && pass.height > 0) {
+            passes.push_back(pass);
+        }
+    }
+    return passes;
+}
+
+// Function to get the size of the unfiltered image data, the sum of the scanlines of all passes
+size_t pngImageDataSize(const PNGInfo& info) {
+    size_t size = 0;
+    for (const PNGPass& pass : pngPasses(info)) {
+        size += pass.stride * pass.height;
+    }
+    return size;
+}
+
+// Paeth predictor from the PNG specification
+unsigned char paethPredictor(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+// Function to undo the filter of one scanline in place.
+// prev is the previous unfiltered scanline, all zeros for the first one.
+void unfilterScanline(unsigned char filterType, unsigned char* row, const unsigned char* prev, size_t length, size_t unit) {
+    switch (filterType) {
+        case 0: // None
+            break;
+        case 1: // Sub
+            for (size_t i = unit; i < length; ++i) row[i] += row[i - unit];
+            break;
+        case 2: // Up
+            for (size_t i = 0; i < length; ++i) row[i] += prev[i];
+            break;
+        case 3: // Average
+            for (size_t i = 0; i < length; ++i) {
+                int left = i >= unit ? row[i - unit] : 0;
+                row[i] += (left + prev[i]) / 2;
+            }
+            break;
+        case 4: // Paeth
+            for (size_t i = 0; i < length; ++i) {
+                int left = i >= unit ? row[i - unit] : 0;
+                int upperLeft = i >= unit ? prev[i - unit] : 0;
+                row[i] += paethPredictor(left, prev[i], upperLeft);
+            }
+            break;
+        default:
+            throw std::runtime_error("Invalid PNG filter type.");
+    }
+}
+
+// Function to inflate the IDAT stream chunk by chunk and hand every unfiltered scanline to onRow(row, length).
+// Interlaced images are not de-interlaced: the scanlines of the seven passes arrive in data stream order.
+// Decoding stops as soon as onRow returns false, so callers that only need the first rows
+// never read or inflate the rest of the image.
+template <typename RowCallback>
+void streamPNGRows(std::istream& file, PNGInfo& info, RowCallback&& onRow) {
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) {
+        throw std::runtime_error("Could not initialise PNG decompression.");
+    }
+
+    std::vector<PNGPass> passes = pngPasses(info);
+    size_t passIndex = 0;
+    uint32_t rowIndex = 0; // scanline within the current pass
+    std::vector<unsigned char> chunk;
+    std::vector<unsigned char> row(info.stride + 1);
+    std::vector<unsigned char> prev(info.stride + 1, 0);
+    size_t rowSize = passes.empty() ? 0 : passes[0].stride + 1;
+    size_t filled = 0;
+    bool stopped = false;
+    bool streamEnded = false;
+    std::streamoff fileEnd = streamEnd(file);
+
+    try {
+        while (!stopped && !streamEnded && passIndex < passes.size()) {
+            uint32_t length = readBigEndian32(file);
+            char type[4];
+            file.read(type, 4);
+            if (!file) {
+                throw std::runtime_error("Unexpected end of PNG file.");
+            }
+            checkPNGChunkLength(file, length, fileEnd);
+
+            if (std::string(type, 4) == "IDAT") {
+                if (info.colorType == 3 && info.paletteEntries == 0) {
+                    throw std::runtime_error("Palette PNG file without a PLTE chunk.");
+                }
+                {
+                    STATS_TIMER(Read);
+                    STATS_ADD(BytesRead, length + 12);
+                    chunk.resize(length);
+                    readPNGChunkData(file, reinterpret_cast<char*>(chunk.data()), length);
+                    file.seekg(4, std::ios::cur); // Skip CRC
+                }
+                STATS_TIMER(Decode);
+                stream.next_in = chunk.data();
+                stream.avail_in = length;
+
+                while (passIndex < passes.size()) {
+                    stream.next_out = row.data() + filled;
+                    stream.avail_out = rowSize - filled;
+                    int result = inflate(&stream, Z_NO_FLUSH);
+                    if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+                        throw std::runtime_error("Corrupted PNG image data.");
+                    }
+                    // A full output buffer means zlib may still hold decoded bytes even without input left
+                    bool outputFull = stream.avail_out == 0;
+                    filled = rowSize - stream.avail_out;
+                    if (filled == rowSize) {
+                        unfilterScanline(row[0], row.data() + 1, prev.data() + 1, rowSize - 1, info.filterUnit);
+                        if (!onRow(reinterpret_cast<const char*>(row.data() + 1), rowSize - 1)) {
+                            stopped = true;
+                            break;
+                        }
+                        std::swap(row, prev);
+                        filled = 0;
+                        if (++rowIndex == passes[passIndex].height) {
+                            // Every pass is filtered on its own, its first scanline has no previous one
+                            rowIndex = 0;
+                            if (++passIndex < passes.size()) {
+                                rowSize = passes[passIndex].stride + 1;
+                                std::fill(prev.begin(), prev.end(), 0);
+                            }
+                        }
+                    }
+                    if (result == Z_STREAM_END) {
+                        streamEnded = true;
+                        break;
+                    }
+                    if (result == Z_BUF_ERROR || (!outputFull && stream.avail_in == 0)) {
+                        break; // zlib needs the next chunk
+                    }
+                }
+            } else if (std::string(type, 4) == "IEND") {
+                break;
+            } else if (stream.total_in == 0) {
+                // Chunk before the image data: keep it so the image can be rewritten unchanged
+                STATS_TIMER(Read);
+                STATS_ADD(BytesRead, length + 12);
+                std::string data(length, '\0');
+                readPNGChunkData(file, data.data(), length);
+                file.seekg(4, std::ios::cur); // Skip CRC
+                if (std::string(type, 4) == "PLTE") {
+                    info.paletteEntries = length / 3;
+                }
+                info.extraChunks.emplace_back(std::string(type, 4), std::move(data));
+            } else {
+                file.seekg(length + 4, std::ios::cur); // Skip data + CRC
+            }
+        }
+    } catch (...) {
+        inflateEnd(&stream);
+        throw;
+    }
+    inflateEnd(&stream);
+
+    if (!stopped && passIndex < passes.size()) {
+        throw std::runtime_error("PNG image data is truncated.");
+    }
+}
+
+// Function to filter one scanline for writing, choosing the filter with the smallest sum of
+// absolute differences (the heuristic recommended by the PNG specification).
+// out receives the filter type byte followed by the filtered bytes.
+void filterScanline(const unsigned char* row, const unsigned char* prev, size_t length, size_t unit, unsigned char* out) {
+    unsigned char candidate[5];
+    long bestSum = -1;
+    for (unsigned char filterType = 0; filterType < 5; ++filterType) {
+        long sum = 0;
+        for (size_t i = 0; i < length; ++i) {
+            int left = i >= unit ? row[i - unit] : 0;
+            int upperLeft = i >= unit ? prev[i - unit] : 0;
+            candidate[0] = row[i];
+            candidate[1] = row[i] - left;
+            candidate[2] = row[i] - prev[i];
+            candidate[3] = row[i] - (left + prev[i]) / 2;
+            candidate[4] = row[i] - paethPredictor(left, prev[i], upperLeft);
+            sum += std::abs(static_cast<signed char>(candidate[filterType]));
+        }
+        if (bestSum < 0 || sum < bestSum) {
+            bestSum = sum;
+            out[0] = filterType;
+        }
+    }
+    for (size_t i = 0; i < length; ++i) {
+        int left = i >= unit ? row[i - unit] : 0;
+        int upperLeft = i >= unit ? prev[i - unit] : 0;
+        switch (out[0]) {
+            case 0: out[i + 1] = row[i]; break;
+            case 1: out[i + 1] = row[i] - left; break;
+            case 2: out[i + 1] = row[i] - prev[i]; break;
+            case 3: out[i + 1] = row[i] - (left + prev[i]) / 2; break;
+            default: out[i + 1] = row[i] - paethPredictor(left, prev[i], upperLeft); break;
+        }
+    }
+}
+
+// Function to filter and deflate unfiltered scanlines (in data stream order) into the contents of the IDAT chunks.
+// Throws if zlib fails, so a carrier is never rewritten with incomplete image data.
+PooledBuffer compressPNGRows(const PNGInfo& info, const PooledBuffer& imageData) {
+    STATS_TIMER(Encode);
+    z_stream stream{};
+    if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        throw std::runtime_error("Could not initialise PNG compression.");
+    }
+    auto fail = [&stream]() {
+        deflateEnd(&stream);
+        throw std::runtime_error("Could not compress the PNG image data.");
+    };
+
+    std::vector<PNGPass> passes = pngPasses(info);
+    std::vector<unsigned char> filtered(info.stride + 1);
+    std::vector<unsigned char> zeros(info.stride, 0);
+    // The whole output goes into one buffer, so its size has to fit zlib's 32 bit counts
+    uLong bound = deflateBound(&stream, imageData.size() + info.height * passes.size());
+    if (bound > std::numeric_limits<uInt>::max() || info.stride + 1 > std::numeric_limits<uInt>::max()) {
+        deflateEnd(&stream);
+        throw std::runtime_error("PNG image data too large to compress.");
+    }
+    PooledBuffer compressed = BufferPool::local().acquire(bound);
+    stream.next_out = reinterpret_cast<unsigned char*>(compressed.data());
+    stream.avail_out = static_cast<uInt>(compressed.size());
+
+    auto row = reinterpret_cast<const unsigned char*>(imageData.data());
+    for (const PNGPass& pass : passes) {
+        for (uint32_t y = 0; y < pass.height; ++y) {
+            const unsigned char* prev = y == 0 ? zeros.data() : row - pass.stride;
+            filterScanline(row, prev, pass.stride, info.filterUnit, filtered.data());
+            stream.next_in = filtered.data();
+            stream.avail_in = static_cast<uInt>(pass.stride + 1);
+            if (deflate(&stream, Z_NO_FLUSH) != Z_OK || stream.avail_in != 0) {
+                fail();
+            }
+            row += pass.stride;
+        }
+    }
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        fail();
+    }
+    compressed.shrink(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+// Function to read the chunks after the image data into info.trailingChunks, so the image can be rewritten
+// with them. The stream has to be at the chunk after the last IDAT chunk streamPNGRows read; IDAT chunks it
+// did not need are skipped. A file that ends without IEND ends the chunks too.
+void readPNGTrailingChunks(std::istream& file, PNGInfo& info) {
+    STATS_TIMER(Read);
+    std::streamoff fileEnd = streamEnd(file);
+    while (true) {
+        uint32_t length = readBigEndian32(file);
+        char type[4];
+        file.read(type, 4);
+        if (!file) {
+            return;
+        }
+        checkPNGChunkLength(file, length, fileEnd);
+        std::string chunkType(type, 4);
+        if (chunkType == "IEND") {
+            return;
+        }
+        if (chunkType == "IDAT") {
+            file.seekg(length + 4, std::ios::cur); // Skip data + CRC
+            continue;
+        }
+        STATS_ADD(BytesRead, length + 12);
+        std::string data(length, '\0');
+        readPNGChunkData(file, data.data(), length);
+        file.seekg(4, std::ios::cur); // Skip CRC
+        info.trailingChunks.emplace_back(std::move(chunkType), std::move(data));
+    }
+}
+
+// Function to write one PNG chunk: big endian length, type, data and the CRC over type and data
+void writePNGChunk(std::ostream& outfile, const char type[4], const char* data, uint32_t length) {
+    STATS_ADD(BytesWritten, length + 12);
+    uint32_t lengthBigEndian = __builtin_bswap32(length);
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+    if (length > 0) {
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(data), length);
+    }
+    uint32_t crcBigEndian = __builtin_bswap32(static_cast<uint32_t>(crc));
+
+    outfile.write(reinterpret_cast<char*>(&lengthBigEndian), 4);
+    outfile.write(type, 4);
+    outfile.write(data, length);
+    outfile.write(reinterpret_cast<char*>(&crcBigEndian), 4);
+}
@@ -4,24 +4,27 @@
 #include "printLastModificationTime.cpp"
 #include "printLastStatusChangeTime.cpp"
 #include "printFilePermissions.cpp"
+#include "printImageInfo.cpp"
 
 
 // https://www.oreilly.com/library/view/c-cookbook/0596007612/ch10s07.html
 // https://www.ibm.com/docs/en/i/7.3.0?topic=ssw_ibm_i_73/apis/stat.htm
-void printFileInfo(const char* filename) {
-    try {
-        struct stat fileInfo;
-
-        if (stat(filename, &fileInfo) != 0) {
-            throw std::runtime_error(strerror(errno)); // Throw an exception with the error message
-        }
-        printFileName(filename);
-        printFileSize(fileInfo.st_size); // Regular File: The number of data bytes in the file.
-        printLastAccessTime(fileInfo.st_mtime);
-        printLastModificationTime(fileInfo.st_mtime); // The most recent time the contents of the file were changed.
-        printLastStatusChangeTime(fileInfo.st_ctime); // The most recent time the status of the file was changed.
-        printFilePermissions(fileInfo.st_mode); // A bit string indicating the permissions and privileges of the file
-    } catch (const std::runtime_error& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
+// Function to print the information read by readFileInfo
+void printFileInfo(const FileInfoRecord& record) {
+    if (!record.status) {
+        std::cerr << "Error: " << record.error << std::endl;
+        return;
+    }
+    const FileStatus& status = *record.status;
+    printFileName(record.filename.c_str());
+    printFileSize(status.size); // Regular File: The number of data bytes in the file.
+    printLastAccessTime(status.accessTime); // The most recent time the data of the file was read.
+    printLastModificationTime(status.modificationTime); // The most recent time the contents of the file were changed.
+    printLastStatusChangeTime(status.statusChangeTime); // The most recent time the status of the file was changed.
+    printFilePermissions(status.mode); // A bit string indicating the permissions and privileges of the file
+    if (record.image) {
+        printImageInfo(*record.image); // Header fields and capacity, no pixel data is read
+    } else {
+        std::cerr << "Error: " << record.error << std::endl;
     }
 }
\ No newline at end of file
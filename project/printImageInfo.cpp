@@ -0,0 +1,18 @@
+void printImageInfo(const ImageInfo& image) {
+    try {
+        std::cout << "Image: " << image.width << " x " << image.height << ", " << image.bitsPerPixel << " bits per pixel, "
+                  << image.colorType << (image.interlaced ? ", interlaced" : "") << std::endl;
+        std::cout << "Row stride: " << image.rowStride << " bytes" << std::endl;
+        if (image.format == "png") {
+            std::cout << "Chunks before image data: " << image.headerChunks << std::endl;
+        }
+        std::cout << "Maximum message: " << image.maxMessage << " bytes" << std::endl;
+        std::cout << "Capacity by LSB depth:";
+        for (size_t depth = 1; depth <= image.capacity.size(); ++depth) {
+            std::cout << ' ' << depth << ": " << image.capacity[depth - 1] << (depth < image.capacity.size() ? "," : "");
+        }
+        std::cout << " bytes" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error printing image information: " << e.what() << std::endl;
+    }
+}
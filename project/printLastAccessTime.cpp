@@ -1,6 +1,7 @@
-void printLastAccessTime(const time_t time) {
+void printLastAccessTime(const timespec& time) {
     try{
-        std::cout << "Last access time: " << std::ctime(&time);
+        char text[isoTimestampSize];
+        std::cout << "Last access time: " << formatISO8601(time, text) << '\n';
     } catch (const std::exception& e) {
         std::cerr << "Error printing last access time: " << e.what() << std::endl;
     }
@@ -1,6 +1,7 @@
-void printLastModificationTime(const time_t time) {
+void printLastModificationTime(const timespec& time) {
     try{
-        std::cout << "Last modification time: " << std::ctime(&time);
+        char text[isoTimestampSize];
+        std::cout << "Last modification time: " << formatISO8601(time, text) << '\n';
     } catch (const std::exception& e) {
         std::cerr << "Error printing last modification time: " << e.what() << std::endl;
     }
@@ -1,6 +1,7 @@
-void printLastStatusChangeTime(const time_t time) {
+void printLastStatusChangeTime(const timespec& time) {
     try{
-        std::cout << "Last status change time: " << std::ctime(&time);
+        char text[isoTimestampSize];
+        std::cout << "Last status change time: " << formatISO8601(time, text) << '\n';
     } catch (const std::exception& e) {
         std::cerr << "Error printing last status change time: " << e.what() << std::endl;
     }
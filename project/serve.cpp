@@ -0,0 +1,185 @@
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <poll.h>
+#include <set>
+
+// --serve <socket>: a long running process answering embed, extract, check and info requests from
+// --connect clients (see serveProtocol.cpp), so a caller that embeds many small messages pays neither the
+// start of a process nor the first use of the buffer pools and the metadata cache for each of them.
+// Connections are served by a fixed set of worker threads, one connection per thread at a time; each
+// worker keeps its own buffer pool warm. Headers read by any worker are shared through the metadata
+// cache, which lives in memory and, with --cache, is also written to its file after every connection.
+// Each request is carried out with the embedding options the client sent along (requestEmbedding).
+// SIGINT or SIGTERM stops the server once the requests in progress are answered.
+
+std::atomic<bool> serveStopping{false};
+
+extern "C" void stopServing(int) {
+    serveStopping = true;
+}
+
+// Function to get the lock that orders the requests for one file, so an extraction never sees half of an embedding.
+// The lock is chosen by device and inode, so other paths to the same file (./, .., symlinks) share it.
+std::mutex& serveFileLock(const std::string& path) {
+    static std::mutex locks[64];
+    FileStatus status = readFileStatus(path);
+    uint64_t hash = static_cast<uint64_t>(status.inode) * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(status.device);
+    return locks[(hash ^ (hash >> 29)) % std::size(locks)];
+}
+
+// Function to carry out a request; returns the payload of its response
+std::string handleServeRequest(const ServeRequest& request) {
+    std::string extension = fileExtensionOf(request.path);
+    if (extension != "bmp" && extension != "png") {
+        throw std::runtime_error("Unsupported file format. Only .bmp and .png are supported.");
+    }
+    switch (request.operation) {
+    case ServeOperation::Embed: {
+        std::lock_guard lock(serveFileLock(request.path));
+        if (extension == "bmp") {
+            writeMessageToBMP(request.path, request.message);
+        } else {
+            writeMessageToPNG(request.path, request.message);
+        }
+        return {};
+    }
+    case ServeOperation::Extract: {
+        std::lock_guard lock(serveFileLock(request.path));
+        return extension == "bmp" ? readMessageFromBMP(request.path) : readMessageFromPNG(request.path);
+    }
+    case ServeOperation::Check:
+        return std::string(1, canWriteMessage(request.path, request.message) ? 1 : 0);
+    case ServeOperation::Info: {
+        FileInfoRecord record = readFileInfo(request.path);
+        if (!record.error.empty()) {
+            throw std::runtime_error(record.error);
+        }
+        InfoWriter writer(false);
+        writer.add(record);
+        return writer.take();
+    }
+    }
+    throw std::runtime_error("Unknown operation.");
+}
+
+// Function to answer the requests of a connection until the client closes it
+void serveConnection(int fd) {
+    std::string body;
+    try {
+        while (receiveFrame(fd, body)) {
+            std::string response(1, static_cast<char>(ServeStatus::Ok));
+            try {
+                ServeRequest request = decodeServeRequest(body);
+                requestEmbedding = &request.embedding; // the engine embeds and extracts with the client's options
+                response += handleServeRequest(request);
+            } catch (const std::exception& e) {
+                response.assign(1, static_cast<char>(ServeStatus::Error));
+                response += e.what();
+            }
+            requestEmbedding = nullptr;
+            if (!sendFrame(fd, response)) {
+                return;
+            }
+        }
+    } catch (const std::exception& e) { // the framing is lost, so is the connection
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
+
+// Function to serve requests on the Unix socket at socketPath until SIGINT or SIGTERM
+int runServer(const std::string& socketPath) {
+    sockaddr_un address = serveAddress(socketPath);
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error(strerror(errno));
+    }
+    struct stat socketInfo{};
+    if (lstat(socketPath.c_str(), &socketInfo) == 0 && S_ISSOCK(socketInfo.st_mode)) {
+        unlink(socketPath.c_str()); // left behind by a server that did not stop cleanly
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+        std::string error = strerror(errno);
+        close(listenFd);
+        throw std::runtime_error("Could not listen on " + socketPath + ": " + error);
+    }
+    if (!metadataCache.enabled()) {
+        metadataCache.openInMemory();
+    }
+    struct sigaction action{};
+    action.sa_handler = stopServing;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    unsigned workerCount = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Serving on " << socketPath << " with " << workerCount << " workers." << std::endl;
+    std::streambuf* output = std::cout.rdbuf(nullptr); // the progress lines of the engine have no reader here
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<int> waiting; // accepted connections no worker has taken yet
+    std::set<int> active;    // connections being served
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < workerCount; ++i) {
+        workers.emplace_back([&]() {
+            while (true) {
+                int fd;
+                {
+                    std::unique_lock lock(mutex);
+                    ready.wait(lock, [&]() { return !waiting.empty() || serveStopping; });
+                    if (waiting.empty()) {
+                        return;
+                    }
+                    fd = waiting.front();
+                    waiting.pop_front();
+                    active.insert(fd);
+                }
+                serveConnection(fd);
+                {
+                    std::lock_guard lock(mutex);
+                    active.erase(fd);
+                }
+                close(fd);
+                try {
+                    metadataCache.flush();
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: Could not update the metadata cache: " << e.what() << std::endl;
+                }
+            }
+        });
+    }
+
+    while (!serveStopping) {
+        pollfd listening{listenFd, POLLIN, 0};
+        if (poll(&listening, 1, 250) <= 0) {
+            continue; // timeout or signal: check serveStopping again
+        }
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        std::lock_guard lock(mutex);
+        waiting.push_back(fd);
+        ready.notify_one();
+    }
+
+    close(listenFd);
+    unlink(socketPath.c_str());
+    {
+        std::lock_guard lock(mutex);
+        for (int fd : waiting) {
+            close(fd);
+        }
+        waiting.clear();
+        for (int fd : active) {
+            shutdown(fd, SHUT_RD); // the worker answers the request it has, then sees the end of the stream
+        }
+    }
+    ready.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::cout.rdbuf(output);
+    std::cout << "Stopped serving on " << socketPath << "." << std::endl;
+    return 0;
+}
@@ -0,0 +1,92 @@
+// --connect <socket>: runs -i, -e, -d and -c through a --serve process instead of in this one.
+// Paths are made absolute first, as the server may run in another directory. Output matches the
+// local flags, except that -i prints JSON records (as --format json) whatever --format says. Every request
+// carries this process's embedding options.
+
+class ServeClient {
+public:
+    explicit ServeClient(const std::string& socketPath) {
+        sockaddr_un address = serveAddress(socketPath);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            std::string error = strerror(errno);
+            if (fd >= 0) {
+                close(fd);
+            }
+            throw std::runtime_error("Could not connect to " + socketPath + ": " + error);
+        }
+    }
+
+    ~ServeClient() {
+        close(fd);
+    }
+
+    ServeClient(const ServeClient&) = delete;
+    ServeClient& operator=(const ServeClient&) = delete;
+
+    // Function to send a request and wait for its response; false with the error in payload if it failed
+    bool call(ServeOperation operation, const std::string& path, const std::string& message, std::string& payload) {
+        ServeRequest request{operation, std::filesystem::absolute(path).string(), message, options.embedding};
+        std::string body;
+        if (!sendFrame(fd, encodeServeRequest(request)) || !receiveFrame(fd, body)) {
+            throw std::runtime_error("The server closed the connection.");
+        }
+        payload = body.substr(1);
+        return static_cast<ServeStatus>(body[0]) == ServeStatus::Ok;
+    }
+
+private:
+    int fd = -1;
+};
+
+// Function to run the flag in argv (as main gets it, without the options) on the server; returns the exit code
+int runClient(const std::string& socketPath, int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Error: Incorrect number of arguments for the given flag." << std::endl;
+        return 1;
+    }
+    ServeClient client(socketPath);
+    std::string flag = argv[1];
+    std::string payload;
+    bool allSucceeded = true;
+    if (flag == "-i" || flag == "--info") {
+        for (const std::string& filename : expandInfoPaths(std::vector<std::string>(argv + 2, argv + argc))) {
+            if (client.call(ServeOperation::Info, filename, {}, payload)) {
+                std::cout << payload;
+            } else {
+                std::cerr << filename << ": Error: " << payload << std::endl;
+                allSucceeded = false;
+            }
+        }
+    } else if ((flag == "-e" || flag == "--encrypt") && argc >= 4) {
+        std::string message = argv[argc - 1];
+        for (int i = 2; i < argc - 1; ++i) {
+            if (client.call(ServeOperation::Embed, argv[i], message, payload)) {
+                std::cout << "Message successfully written to " << argv[i] << std::endl;
+            } else {
+                std::cerr << argv[i] << ": Error: " << payload << std::endl;
+                allSucceeded = false;
+            }
+        }
+    } else if (flag == "-d" || flag == "--decrypt") {
+        for (int i = 2; i < argc; ++i) {
+            if (client.call(ServeOperation::Extract, argv[i], {}, payload)) {
+                std::cout << (argc > 3 ? std::string(argv[i]) + ": " : "") << "Decrypted message: " << payload << std::endl;
+            } else {
+                std::cerr << argv[i] << ": Error: " << payload << std::endl;
+                allSucceeded = false;
+            }
+        }
+    } else if ((flag == "-c" || flag == "--check") && argc == 4) {
+        if (!client.call(ServeOperation::Check, argv[2], argv[3], payload)) {
+            std::cerr << "Error: " << payload << std::endl;
+            return 1;
+        }
+        std::cout << (payload == std::string(1, 1) ? "The message can be written to the image."
+                                                    : "The message cannot be written to the image.") << std::endl;
+    } else {
+        std::cerr << "Error: Invalid flag or arguments for --connect: " << flag << std::endl;
+        return 1;
+    }
+    return allSucceeded ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Binary protocol of --serve and --connect over a Unix socket. A connection carries any number of
+// requests, each answered before the next one is read. All integers are little endian.
+//   request:  u32 length of the rest | u8 operation | embedding | u32 path length | path | u32 message length | message
+//   embedding: u8 mode (0 lsb, 1 matching, 2 hamming, 3 stc) | u8 Hamming bits | u8 STC height | u8 STC width
+//              | u8 flags (1: checksums) | u64 seed
+//   response: u32 length of the rest | u8 status | payload
+// The embedding fields are the client's --embedding, --stc-width, --checksums and --seed; the server
+// carries the request out with them.
+// The payload of a successful response is empty for embed, the message for extract, one byte (1 if the
+// message fits) for check and a JSON record as --info --format json prints it for info. The payload of
+// a failed response is the error message.
+
+enum class ServeOperation : uint8_t { Embed = 1, Extract = 2, Check = 3, Info = 4 };
+enum class ServeStatus : uint8_t { Ok = 0, Error = 1 };
+
+// Largest request or response accepted, so a bad peer cannot make the other side allocate without bound
+const uint32_t serveMaxFrame = 64 * 1024 * 1024;
+
+struct ServeRequest {
+    ServeOperation operation = ServeOperation::Info;
+    std::string path;
+    std::string message;
+    EmbeddingOptions embedding;
+};
+
+// Embedding modes in the order of their numbers in a request
+const char* const serveEmbeddingModes[] = {"lsb", "matching", "hamming", "stc"};
+const size_t serveEmbeddingSize = 13;
+
+// Function to append value as 4 little endian bytes
+void appendUint32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Function to append value as 8 little endian bytes
+void appendUint64(std::string& out, uint64_t value) {
+    appendUint32(out, static_cast<uint32_t>(value));
+    appendUint32(out, static_cast<uint32_t>(value >> 32));
+}
+
+// Function to read 4 little endian bytes at offset
+uint32_t readUint32(std::string_view data, size_t offset) {
+    if (offset + 4 > data.size()) {
+        throw std::runtime_error("Truncated request.");
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(data[offset + i])) << (8 * i);
+    }
+    return value;
+}
+
+// Function to read 8 little endian bytes at offset
+uint64_t readUint64(std::string_view data, size_t offset) {
+    return readUint32(data, offset) | static_cast<uint64_t>(readUint32(data, offset + 4)) << 32;
+}
+
+// Function to send all of data; false if the peer went away
+bool sendAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t count = send(fd, data, size, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Function to receive exactly size bytes; false on end of stream or error
+bool receiveAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t count = recv(fd, data, size, 0);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Function to send one frame: its length, then body
+bool sendFrame(int fd, const std::string& body) {
+    std::string frame;
+    frame.reserve(4 + body.size());
+    appendUint32(frame, static_cast<uint32_t>(body.size()));
+    frame += body;
+    return sendAll(fd, frame.data(), frame.size());
+}
+
+// Function to receive one frame into body; false when the peer closed the connection
+bool receiveFrame(int fd, std::string& body) {
+    char length[4];
+    if (!receiveAll(fd, length, sizeof(length))) {
+        return false;
+    }
+    uint32_t size = readUint32(std::string_view(length, sizeof(length)), 0);
+    if (size == 0 || size > serveMaxFrame) {
+        throw std::runtime_error("Invalid frame length.");
+    }
+    body.resize(size);
+    if (!receiveAll(fd, body.data(), size)) {
+        throw std::runtime_error("Connection closed in the middle of a frame.");
+    }
+    return true;
+}
+
+// Function to get the body of a request frame
+std::string encodeServeRequest(const ServeRequest& request) {
+    std::string body;
+    body.push_back(static_cast<char>(request.operation));
+    const EmbeddingOptions& embedding = request.embedding;
+    auto mode = std::ranges::find(serveEmbeddingModes, embedding.mode) - std::begin(serveEmbeddingModes);
+    body.push_back(static_cast<char>(mode));
+    body.push_back(static_cast<char>(embedding.hammingBits));
+    body.push_back(static_cast<char>(embedding.stcHeight));
+    body.push_back(static_cast<char>(embedding.stcWidth));
+    body.push_back(static_cast<char>(embedding.checksums ? 1 : 0));
+    appendUint64(body, embedding.seed);
+    appendUint32(body, static_cast<uint32_t>(request.path.size()));
+    body += request.path;
+    appendUint32(body, static_cast<uint32_t>(request.message.size()));
+    body += request.message;
+    return body;
+}
+
+// Function to parse the body of a request frame
+ServeRequest decodeServeRequest(std::string_view body) {
+    ServeRequest request;
+    request.operation = static_cast<ServeOperation>(body.at(0));
+    if (1 + serveEmbeddingSize > body.size()) {
+        throw std::runtime_error("Truncated request.");
+    }
+    unsigned mode = static_cast<unsigned char>(body[1]);
+    EmbeddingOptions& embedding = request.embedding;
+    embedding.hammingBits = static_cast<unsigned char>(body[2]);
+    embedding.stcHeight = static_cast<unsigned char>(body[3]);
+    embedding.stcWidth = static_cast<unsigned char>(body[4]);
+    embedding.checksums = body[5] & 1;
+    embedding.seed = readUint64(body, 6);
+    if (mode >= std::size(serveEmbeddingModes) || embedding.hammingBits < 2 || embedding.hammingBits > 8 ||
+        embedding.stcHeight < SyndromeTrellisCode::minHeight || embedding.stcHeight > SyndromeTrellisCode::maxHeight ||
+        embedding.stcWidth < 2 || embedding.stcWidth > 32) {
+        throw std::runtime_error("Invalid embedding options in request.");
+    }
+    embedding.mode = serveEmbeddingModes[mode];
+    size_t pathOffset = 1 + serveEmbeddingSize;
+    uint32_t pathLength = readUint32(body, pathOffset);
+    if (pathOffset + 4 + size_t(pathLength) > body.size()) {
+        throw std::runtime_error("Truncated request.");
+    }
+    request.path = body.substr(pathOffset + 4, pathLength);
+    size_t messageOffset = pathOffset + 4 + size_t(pathLength);
+    uint32_t messageLength = readUint32(body, messageOffset);
+    if (messageOffset + 4 + messageLength != body.size()) {
+        throw std::runtime_error("Malformed request.");
+    }
+    request.message = body.substr(messageOffset + 4, messageLength);
+    return request;
+}
+
+// Function to get the address of the socket at path
+sockaddr_un serveAddress(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
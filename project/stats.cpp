@@ -0,0 +1,142 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+
+// Phase timers and counters for --stats; with --trace every timer also records a span (see trace.cpp).
+// STATS_TIMER(Phase) times the rest of the enclosing scope (STATS_TIMER_FOR when the phase is computed)
+// and STATS_ADD(Counter, value) adds to a counter.
+// Timers measure exclusive time: a nested timer pauses the one around it, so the phases add up to the
+// time of the whole run. Without --stats and --trace a timer costs one branch; building with STEGO_STATS=0
+// removes the timers, counters and trace spans entirely.
+
+#ifndef STEGO_STATS
+#define STEGO_STATS 1
+#endif
+
+enum class StatPhase { Open, HeaderParse, Read, Decode, Embed, Extract, Analyze, Encode, Write, Fsync, Wait, Count };
+enum class StatCounter { BytesRead, BytesWritten, BitsEmbedded, BitsExtracted, CarrierBytesModified, Syscalls, CacheHits, CacheMisses, Count };
+
+const char* const statPhaseNames[] = {"open", "header parse", "read", "decode", "embed", "extract", "analyze", "encode", "write", "fsync", "I/O wait"};
+const char* const statCounterNames[] = {"Bytes read", "Bytes written", "Bits embedded", "Bits extracted",
+                                        "Carrier bytes modified", "System calls", "Metadata cache hits", "Metadata cache misses"};
+
+// Totals of the run; updated from any thread
+struct Stats {
+    std::array<std::atomic<uint64_t>, size_t(StatPhase::Count)> nanoseconds{};
+    std::array<std::atomic<uint64_t>, size_t(StatPhase::Count)> calls{};
+    std::array<std::atomic<uint64_t>, size_t(StatCounter::Count)> counters{};
+};
+
+Stats stats;
+
+// Function to add value to a counter
+inline void addStat(StatCounter counter, uint64_t value) {
+    stats.counters[size_t(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+// Times a phase from construction to destruction, less the time of the timers nested inside it
+class ScopedTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ScopedTimer(StatPhase phase) : phase(phase) {
+        if (!options.stats && !options.trace) {
+            return;
+        }
+        active = true;
+        outerChildTime = childTime;
+        childTime = {};
+        start = Clock::now();
+    }
+
+    ~ScopedTimer() {
+        if (!active) {
+            return;
+        }
+        Clock::time_point end = Clock::now();
+        Clock::duration total = end - start;
+        if (options.stats) {
+            Clock::duration exclusive = total - childTime;
+            stats.nanoseconds[size_t(phase)].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(exclusive).count(), std::memory_order_relaxed);
+            stats.calls[size_t(phase)].fetch_add(1, std::memory_order_relaxed);
+        }
+        if (options.trace) {
+            tracer.record(statPhaseNames[size_t(phase)], start, end);
+        }
+        childTime = outerChildTime + total; // the enclosing timer does not count this one
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    static inline thread_local Clock::duration childTime{}; // time of the nested timers of the innermost running timer
+
+    StatPhase phase;
+    bool active = false;
+    Clock::time_point start;
+    Clock::duration outerChildTime{};
+};
+
+#define STATS_CONCAT_INNER(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_INNER(a, b)
+#if STEGO_STATS
+#define STATS_TIMER(phase) ScopedTimer STATS_CONCAT(statsTimer, __LINE__)(StatPhase::phase)
+#define STATS_TIMER_FOR(phaseValue) ScopedTimer STATS_CONCAT(statsTimer, __LINE__)(phaseValue)
+#define STATS_ADD(counter, value) do { if (options.stats) addStat(StatCounter::counter, value); } while (0)
+#define TRACE_FILE(filename) TraceFileScope STATS_CONCAT(traceFile, __LINE__)(options.trace ? tracer.fileId(filename) : Tracer::currentFile)
+#define TRACE_FILE_ID(id) TraceFileScope STATS_CONCAT(traceFile, __LINE__)(id)
+#define TRACE_IO(name, start, end, id) do { if (options.trace) tracer.record(name, start, end, id); } while (0)
+#else
+#define STATS_TIMER(phase) do {} while (0)
+#define STATS_TIMER_FOR(phaseValue) do {} while (0)
+#define STATS_ADD(counter, value) do { (void)sizeof(value); } while (0)
+#define TRACE_FILE(filename) do {} while (0)
+#define TRACE_FILE_ID(id) do {} while (0)
+#define TRACE_IO(name, start, end, id) do {} while (0)
+#endif
+
+// Function to print the phase times and counters of the run
+void printStats() {
+    if (!STEGO_STATS) {
+        std::cerr << "Statistics are not available in this build (STEGO_STATS=0)." << std::endl;
+        return;
+    }
+    std::cerr << "Statistics:" << std::endl;
+    std::cerr << "  " << std::left << std::setw(14) << "Phase" << std::right << std::setw(10) << "Calls"
+              << std::setw(14) << "Time (ms)" << std::endl;
+    uint64_t totalNanoseconds = 0;
+    for (size_t i = 0; i < size_t(StatPhase::Count); ++i) {
+        uint64_t calls = stats.calls[i].load();
+        if (calls == 0) {
+            continue;
+        }
+        uint64_t nanoseconds = stats.nanoseconds[i].load();
+        totalNanoseconds += nanoseconds;
+        std::cerr << "  " << std::left << std::setw(14) << statPhaseNames[i] << std::right << std::setw(10) << calls
+                  << std::setw(14) << std::fixed << std::setprecision(3) << nanoseconds / 1e6 << std::endl;
+    }
+    std::cerr << "  " << std::left << std::setw(24) << "total" << std::right << std::setw(14)
+              << totalNanoseconds / 1e6 << std::endl;
+    for (size_t i = 0; i < size_t(StatCounter::Count); ++i) {
+        std::cerr << "  " << statCounterNames[i] << ": " << stats.counters[i].load() << std::endl;
+    }
+}
+
+// Prints the --stats summary and writes the --trace file when it goes out of scope at the end of main
+struct RunReport {
+    ~RunReport() {
+        if (options.stats) {
+            printStats();
+        }
+        if (options.trace && !STEGO_STATS) {
+            std::cerr << "Tracing is not available in this build (STEGO_STATS=0)." << std::endl;
+        } else if (options.trace) {
+            try {
+                tracer.write(options.tracePath);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+        }
+    }
+};
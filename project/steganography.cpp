@@ -0,0 +1,316 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <sys/stat.h> // For file information
+#include <ctime>   // For timestamp conversion
+#include <algorithm> // For std::transform
+#include <cstring>
+
+// The steganography engine: reading, embedding and extracting for BMP and PNG carriers.
+// main.cpp (the command line tool) and bench.cpp (the benchmarks) both build on it.
+
+#include "parseOptions.cpp"
+#include "trace.cpp"
+#include "stats.cpp"
+#include "bmpBands.cpp"
+#include "ioBackend.cpp"
+#include "bufferPool.cpp"
+#include "blockChecksums.cpp"
+#include "bitStream.cpp"
+#include "pngStream.cpp"
+#include "pngCarriers.cpp"
+#include "matrixEmbedding.cpp"
+#include "syndromeTrellis.cpp"
+#include "lsbMatching.cpp"
+
+// Number of bytes at the start of a BMP file that hold every header field used here
+const size_t bmpHeaderSize = 30;
+
+// Function to parse the BMP header fields from the first bmpHeaderSize bytes of the file.
+uint32_t parseBMPHeader(const char* header, uint32_t& width, uint32_t& height, uint16_t& bitsPerPixel) {
+    // BMP Header Structure - same as bitmap - used to store images
+    // 2 bytes: "BM" identifier
+    // 4 bytes: File size
+    // 4 bytes: Reserved (unused)
+    // 4 bytes: Data offset (where the pixel data starts)
+    // 4 bytes: Header size
+    // 4 bytes: Image width
+    // 4 bytes: Image height
+    // 2 bytes: Number of color planes
+    // 2 bytes: Bits per pixel
+    if (header[0] != 'B' || header[1] != 'M') {
+        throw std::runtime_error("Not a valid BMP file.");
+    }
+
+    uint32_t dataOffset;
+    std::memcpy(&dataOffset, header + 10, 4); // data offset
+    std::memcpy(&width, header + 18, 4);
+    std::memcpy(&height, header + 22, 4);
+    std::memcpy(&bitsPerPixel, header + 28, 2);
+    if (bitsPerPixel != 24 && bitsPerPixel != 32) {
+        throw std::runtime_error("Only 24 and 32 bits per pixel are supported for BMP.");
+    }
+
+    return dataOffset;
+}
+
+// Function to read BMP file header and extract image data offset.
+uint32_t readBMPHeader(auto& file, uint32_t& width, uint32_t& height, uint16_t& bitsPerPixel) {
+    STATS_TIMER(HeaderParse);
+    file.seekg(0); // Go to the beginning of the file.
+    std::cout << "Reading BMP header..." << std::endl;
+    char header[bmpHeaderSize];
+    file.read(header, bmpHeaderSize);
+    if (!file) {
+        throw std::runtime_error("Not a valid BMP file.");
+    }
+    STATS_ADD(BytesRead, bmpHeaderSize);
+    return parseBMPHeader(header, width, height, bitsPerPixel);
+}
+
+// Function to get file size
+long getFileSize(const std::string& filename) {
+    STATS_ADD(Syscalls, 1);
+    struct stat stat_buf{};
+    if (stat(filename.c_str(), &stat_buf) == 0) {
+        return stat_buf.st_size;
+    }
+    return -1; // Error
+}
+
+// Function to set the LSBs of length bytes to the next message bits; returns the number of bytes that changed
+size_t embedBitsLSB(char* data, size_t length, BitReader& bits) {
+    size_t modified = 0;
+    for (size_t i = 0; i < length; ++i) {
+        setCarrierBit(data[i], bits.next(), modified); // Set the LSB to the message bit
+    }
+    return modified;
+}
+
+// Function to embed the next message bits into the LSBs of a band of pixel data that starts at offset in
+// the file, by replacement or with --embedding matching by +1/-1. The blocks of the file whose bytes
+// changed are added to dirty. Returns the number of bytes that received a bit.
+size_t embedBandBits(char* data, size_t length, BitReader& bits, off_t offset, DirtyRanges& dirty) {
+    STATS_TIMER(Embed);
+    length = std::min(length, bits.remaining());
+    bool matching = embeddingOptions().mode == "matching";
+    for (size_t blockStart = 0; blockStart < length;) {
+        size_t blockEnd = std::min(length, blockStart + DirtyRanges::blockSize - (offset + blockStart) % DirtyRanges::blockSize);
+        size_t modified = matching ? embedBitsMatching(data + blockStart, blockEnd - blockStart, bits, offset + blockStart)
+                                   : embedBitsLSB(data + blockStart, blockEnd - blockStart, bits);
+        if (modified > 0) {
+            dirty.add(blockStart, blockEnd);
+            dirty.modifiedBytes += modified;
+        }
+        STATS_ADD(CarrierBytesModified, modified);
+        blockStart = blockEnd;
+    }
+    STATS_ADD(BitsEmbedded, length);
+    return length;
+}
+
+#include "embeddingModes.cpp"
+
+// Function to write a message into a BMP image; returns the number of carrier bytes that changed.
+// The pixel data is processed in bands of rows that fit into the memory budget and only the bands
+// that receive message bits are read, so images larger than memory work too. Of those only the
+// blocks that changed are written back.
+size_t writeMessageToBMP(const std::string& filename, const std::string& message) {
+    TRACE_FILE(filename);
+    std::fstream file;
+    {
+        STATS_TIMER(Open);
+        file.open(filename, std::ios::in | std::ios::binary);
+    }
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open BMP file for writing.");
+    }
+
+    uint32_t width, height;
+    uint16_t bitsPerPixel;
+    uint32_t dataOffset = readBMPHeader(file, width, height, bitsPerPixel);
+    file.close();
+
+    long fileSize = getFileSize(filename);
+    long messageSize = payloadLength(message.length());
+    long availableBits = (fileSize - dataOffset) * 8 / bitsPerPixel;
+
+    // The message followed by the end of message marker (16 zero bits)
+    BitReader bits(message);
+    bool coded = codedEmbedding();
+    size_t pixelBytes = fileSize - dataOffset;
+    size_t carrierBytes = coded ? embeddingCarrierBytes(bits.size()) : std::min(bits.size(), pixelBytes);
+
+    if (coded ? carrierBytes > pixelBytes : messageSize > availableBits / 8) {
+        throw std::runtime_error("Message is too long to fit in the image.");
+    }
+    if (messageSize == 0) {
+        return 0; // Do nothing
+    }
+
+    FileDescriptor fd(openFile(filename, O_RDWR));
+    if (fd.fd < 0) {
+        throw std::runtime_error("Could not open BMP file for writing.");
+    }
+    size_t bandSize = std::min(bmpBandSize(width, bitsPerPixel), carrierBytes);
+    size_t unit = embeddingUnitBytes();
+    bandSize = std::max(bandSize / unit, size_t(1)) * unit; // whole groups or segments of a code
+    PooledBuffer imageData = BufferPool::local().acquire(bandSize);
+
+    // Embed the message
+    DirtyRanges dirty;
+    for (size_t bandStart = 0; bandStart < carrierBytes; bandStart += bandSize) {
+        size_t length = std::min(bandSize, carrierBytes - bandStart);
+        readAt(fd.fd, imageData.data(), length, dataOffset + bandStart);
+        dirty.clear();
+        embedBand(imageData.data(), length, bits, dataOffset + bandStart, dirty);
+        // Write the modified blocks back into the file.
+        writeDirtyRanges(fd.fd, imageData.data(), dirty, dataOffset + bandStart);
+    }
+    if (dirty.modifiedBytes > 0) {
+        syncFile(fd.fd);
+    }
+
+    std::cout << "Message written to BMP file, " << dirty.modifiedBytes << " bytes modified" << std::endl;
+    return dirty.modifiedBytes;
+}
+
+// Function to read a PNG file and return its unfiltered image data (the scanlines one after another).
+// Interlaced images keep the Adam7 pass order, so embedding walks the seven passes over this single copy.
+// The chunks before and after the image data are kept in info for rewriting the file.
+PooledBuffer readPNG(const std::string& filename, PNGInfo& info) {
+    std::ifstream file;
+    {
+        STATS_TIMER(Open);
+        file.open(filename, std::ios::binary);
+    }
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open PNG file.");
+    }
+
+    readPNGHeader(file, info);
+    PooledBuffer imageData = BufferPool::local().acquire(pngImageDataSize(info));
+    size_t filled = 0;
+    streamPNGRows(file, info, [&](const char* row, size_t length) {
+        std::memcpy(imageData.data() + filled, row, length);
+        filled += length;
+        return true;
+    });
+    readPNGTrailingChunks(file, info);
+    return imageData;
+}
+
+// Function to write a message into a PNG image; returns the number of carrier bytes that changed.
+// The image data is compressed as a whole, so the file is rewritten unless no carrier byte changed.
+size_t writeMessageToPNG(const std::string& filename, const std::string& message) {
+    TRACE_FILE(filename);
+    requireLSBEmbedding("for PNG files");
+    std::cout << "Writing " << message << std::endl;
+
+    PNGInfo info;
+    PooledBuffer imageData = readPNG(filename, info);
+    uint16_t bitsPerPixel = info.channels * info.bitDepth;
+
+    long messageSize = payloadLength(message.length());
+    long availableBits = imageData.size() * 8 / bitsPerPixel;
+    if (messageSize > availableBits / 8) {
+        throw std::runtime_error("Message is too long to fit in the image.");
+    }
+    if (messageSize == 0) {
+        return 0; // Do nothing
+    }
+
+    // The message followed by the end of message marker (16 zero bits)
+    BitReader bits(message);
+    if (bits.size() > pngCarrierCapacity(info, imageData)) {
+        throw std::runtime_error("Message is too long to fit in the image.");
+    }
+
+    // Embed the message with the kernel for this color type and bit depth
+    size_t modified = embedBitsPNG(info, imageData, bits);
+    if (modified == 0) {
+        return 0; // The image already holds the message
+    }
+
+    // Compress before truncating the file, a failure here must not destroy the image
+    PooledBuffer idatData = compressPNGRows(info, imageData);
+
+    // Reconstruct the PNG file with the modified IDAT data
+    std::ofstream outfile;
+    {
+        STATS_TIMER(Open);
+        outfile.open(filename, std::ios::binary);
+    }
+    if (!outfile) {
+        throw std::runtime_error("Could not open PNG file for writing.");
+    }
+    STATS_TIMER(Write);
+
+    // Write the PNG header
+    unsigned char pngHeader[8] = {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A};
+    outfile.write(reinterpret_cast<char*>(pngHeader), 8);
+    STATS_ADD(BytesWritten, 8);
+
+    // IHDR chunk
+    char ihdr[13];
+    uint32_t width_big_endian = __builtin_bswap32(info.width);
+    uint32_t height_big_endian = __builtin_bswap32(info.height);
+    std::memcpy(ihdr, &width_big_endian, 4);
+    std::memcpy(ihdr + 4, &height_big_endian, 4);
+    ihdr[8] = static_cast<char>(info.bitDepth);
+    ihdr[9] = static_cast<char>(info.colorType); // 0 grayscale, 2 RGB, 3 palette, 4 grayscale + alpha, 6 RGBA
+    ihdr[10] = 0; // compression method
+    ihdr[11] = 0; // filter method
+    ihdr[12] = static_cast<char>(info.interlaceMethod);
+    writePNGChunk(outfile, "IHDR", ihdr, 13);
+
+    // PLTE, tRNS and the other chunks that came before the image data
+    for (const auto& [type, data] : info.extraChunks) {
+        writePNGChunk(outfile, type.c_str(), data.data(), data.size());
+    }
+
+    // IDAT chunks, none longer than the PNG limit
+    for (size_t offset = 0; offset < idatData.size(); offset += maxPNGChunkLength) {
+        writePNGChunk(outfile, "IDAT", idatData.data() + offset, std::min<size_t>(maxPNGChunkLength, idatData.size() - offset));
+    }
+
+    // tEXt, eXIf, tIME and the other chunks that came after the image data
+    for (const auto& [type, data] : info.trailingChunks) {
+        writePNGChunk(outfile, type.c_str(), data.data(), data.size());
+    }
+
+    // IEND chunk
+    writePNGChunk(outfile, "IEND", nullptr, 0);
+
+    outfile.close();
+    if (!outfile) {
+        throw std::runtime_error("Could not write PNG file.");
+    }
+    if (options.fsync) {
+        FileDescriptor fd(openFile(filename, O_RDONLY));
+        syncFile(fd.fd);
+    }
+    return modified;
+}
+
+#include "tryal.cpp"
+#include "ioTask.cpp"
+#include "batch.cpp"
+#include "boundedQueue.cpp"
+#include "pipeline.cpp"
+#include "update.cpp"
+#include "timeFormat.cpp"
+#include "fileStatus.cpp"
+#include "imageInfo.cpp"
+#include "metadataCache.cpp"
+#include "canWriteMessage.cpp"
+#include "infoScan.cpp"
+#include "printFileInfo.cpp"
+#include "infoOutput.cpp"
+#include "analyze.cpp"
+#include "serveProtocol.cpp"
+#include "serve.cpp"
+#include "serveClient.cpp"
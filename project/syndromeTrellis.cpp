@@ -0,0 +1,240 @@
+#include <map>
+#include <mutex>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Syndrome-trellis codes (--embedding stc<h>, Filler, Judas and Fridrich): every message bit is the
+// syndrome of the carrier LSBs under a sparse parity check matrix built from a submatrix of h rows and
+// --stc-width w columns, shifted down one row for every message bit. Among all the LSB patterns with the
+// right syndrome the Viterbi algorithm finds one that changes the fewest carrier bytes, which comes close
+// to the bound of what any code of rate 1/w can do; larger constraint heights h come closer and cost
+// 2^h trellis states per carrier byte. Every change costs the same here.
+// The message is coded in independent segments of segmentBits bits, so the trellis path fits in memory
+// and the segments of a large band are embedded by several threads. The weights of 8 trellis states are
+// updated at once with SSE2: the partner states s ^ column of a chunk of 8 states are another chunk,
+// permuted by the low 3 bits of the column.
+
+class SyndromeTrellisCode {
+public:
+    static constexpr size_t segmentBits = 1024; // message bits coded independently
+    static constexpr unsigned minHeight = 4;
+    static constexpr unsigned maxHeight = 12;
+
+    // The code for constraint height and width; built once
+    static const SyndromeTrellisCode& get(unsigned height, unsigned width) {
+        static std::mutex mutex;
+        static std::map<std::pair<unsigned, unsigned>, std::unique_ptr<SyndromeTrellisCode>> codes;
+        std::lock_guard lock(mutex);
+        auto& code = codes[{height, width}];
+        if (!code) {
+            code.reset(new SyndromeTrellisCode(height, width));
+        }
+        return *code;
+    }
+
+    unsigned height() const { return h; }
+    unsigned width() const { return w; }
+    size_t segmentBytes() const { return segmentBits * w; }
+
+    // Function to get the carrier bytes needed for messageBits bits
+    size_t carrierBytes(size_t messageBits) const {
+        return messageBits * w;
+    }
+
+    // Function to embed the next length / w message bits into the LSBs of one segment of length bytes
+    // that starts at offset in the file. path is working memory the caller keeps between segments.
+    void embedSegment(char* data, size_t length, BitReader& bits, off_t offset, DirtyRanges& dirty, std::vector<uint8_t>& path) const {
+        size_t messageBits = length / w;
+        size_t states = size_t(1) << h;
+        size_t chunks = states / 8;
+        std::vector<uint8_t> message(messageBits);
+        for (uint8_t& bit : message) {
+            bit = static_cast<uint8_t>(bits.next());
+        }
+        path.resize(messageBits * w * chunks);
+        std::vector<int16_t> weights(states, infinity), next(states);
+        weights[0] = 0;
+
+        // Forward: weights[s] is the fewest changes that reach state s, the syndrome rows still open
+        for (size_t block = 0; block < messageBits; ++block) {
+            uint32_t rows = (uint32_t(1) << std::min<size_t>(h, messageBits - block)) - 1; // the matrix ends with the segment
+            for (unsigned c = 0; c < w; ++c) {
+                size_t i = block * w + c;
+                int16_t cost0 = data[i] & 1; // LSB 0 is a change when it is 1, LSB 1 when it is 0
+                updateWeights(weights.data(), next.data(), columns[c] & rows, cost0, static_cast<int16_t>(1 - cost0), &path[i * chunks]);
+                weights.swap(next);
+            }
+            // The lowest open row is complete: keep the states whose syndrome bit is the message bit
+            int16_t smallest = infinity;
+            for (size_t s = 0; s < states / 2; ++s) {
+                next[s] = weights[2 * s + message[block]];
+                smallest = std::min(smallest, next[s]);
+            }
+            for (size_t s = 0; s < states / 2; ++s) {
+                next[s] = static_cast<int16_t>(std::min<int>(next[s] - smallest, infinity));
+            }
+            std::fill(next.begin() + states / 2, next.end(), infinity);
+            weights.swap(next);
+        }
+
+        // Backward: follow the path from the only final state, 0, and set the LSBs it chose
+        size_t modified = 0;
+        std::vector<bool> changedBlocks((offset % DirtyRanges::blockSize + length) / DirtyRanges::blockSize + 1);
+        uint32_t state = 0;
+        for (size_t block = messageBits; block-- > 0;) {
+            uint32_t rows = (uint32_t(1) << std::min<size_t>(h, messageBits - block)) - 1;
+            state = (state << 1 | message[block]) & (states - 1);
+            for (unsigned c = w; c-- > 0;) {
+                size_t i = block * w + c;
+                unsigned bit = (path[i * chunks + state / 8] >> (state % 8)) & 1;
+                if (bit) {
+                    state ^= columns[c] & rows;
+                }
+                size_t modifiedBefore = modified;
+                setCarrierBit(data[i], bit, modified);
+                if (modified != modifiedBefore) {
+                    changedBlocks[(offset % DirtyRanges::blockSize + i) / DirtyRanges::blockSize] = true;
+                }
+            }
+        }
+        for (size_t block = 0; block < changedBlocks.size(); ++block) {
+            if (changedBlocks[block]) {
+                size_t position = block * DirtyRanges::blockSize - std::min<size_t>(block * DirtyRanges::blockSize, offset % DirtyRanges::blockSize);
+                dirty.addBlockOf(position, length, offset);
+            }
+        }
+        dirty.modifiedBytes += modified;
+    }
+
+    // Function to pass the bits carried by the carrier bytes to bits, segment by segment.
+    // Returns true as soon as the end of message marker was read.
+    bool extract(const char* data, size_t length, BitWriter& bits) const {
+        for (size_t segment = 0; segment < length; segment += segmentBytes()) {
+            size_t messageBits = std::min(segmentBytes(), length - segment) / w;
+            const char* carrier = data + segment;
+            uint32_t syndrome = 0;
+            for (size_t block = 0; block < messageBits; ++block) {
+                for (unsigned c = 0; c < w; ++c) {
+                    syndrome ^= columns[c] & -static_cast<uint32_t>(carrier[block * w + c] & 1);
+                }
+                if (bits.push(syndrome & 1)) {
+                    return true;
+                }
+                syndrome >>= 1;
+            }
+        }
+        return false;
+    }
+
+private:
+    static constexpr int16_t infinity = 0x3000; // far from overflowing when w costs are added to it
+
+    SyndromeTrellisCode(unsigned height, unsigned width) : h(height), w(width) {
+        // Pseudo random columns with the first and the last row set, which makes good codes; the same
+        // columns in every run, as extraction has to know them
+        uint64_t seed = 0x5354435f434f4445ull ^ (uint64_t(height) << 8) ^ width;
+        for (unsigned c = 0; c < width; ++c) {
+            seed += 0x9e3779b97f4a7c15ull; // splitmix64
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            z ^= z >> 31;
+            columns.push_back((static_cast<uint32_t>(z) & ((uint32_t(1) << height) - 1)) | 1 | (uint32_t(1) << (height - 1)));
+        }
+    }
+
+    // Function to take the weights over one carrier byte: state s comes from s leaving the LSB 0 (cost0)
+    // or from s ^ column setting it to 1 (cost1). Records in path, one bit per state, where 1 was cheaper.
+    void updateWeights(const int16_t* weights, int16_t* next, uint32_t column, int16_t cost0, int16_t cost1, uint8_t* path) const {
+        switch (column & 7) {
+            case 0: updateChunks<0>(weights, next, column, cost0, cost1, path); break;
+            case 1: updateChunks<1>(weights, next, column, cost0, cost1, path); break;
+            case 2: updateChunks<2>(weights, next, column, cost0, cost1, path); break;
+            case 3: updateChunks<3>(weights, next, column, cost0, cost1, path); break;
+            case 4: updateChunks<4>(weights, next, column, cost0, cost1, path); break;
+            case 5: updateChunks<5>(weights, next, column, cost0, cost1, path); break;
+            case 6: updateChunks<6>(weights, next, column, cost0, cost1, path); break;
+            case 7: updateChunks<7>(weights, next, column, cost0, cost1, path); break;
+        }
+    }
+
+    template <unsigned low>
+    void updateChunks(const int16_t* weights, int16_t* next, uint32_t column, int16_t cost0, int16_t cost1, uint8_t* path) const {
+        size_t chunks = (size_t(1) << h) / 8;
+        size_t high = column >> 3;
+#if defined(__SSE2__)
+        __m128i keep = _mm_set1_epi16(cost0), set = _mm_set1_epi16(cost1);
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            __m128i same = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + chunk * 8));
+            __m128i partner = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + (chunk ^ high) * 8));
+            // Lane j takes lane j ^ low
+            if constexpr ((low & 1) != 0) {
+                partner = _mm_shufflehi_epi16(_mm_shufflelo_epi16(partner, 0xb1), 0xb1);
+            }
+            if constexpr ((low & 2) != 0) {
+                partner = _mm_shufflehi_epi16(_mm_shufflelo_epi16(partner, 0x4e), 0x4e);
+            }
+            if constexpr ((low & 4) != 0) {
+                partner = _mm_shuffle_epi32(partner, 0x4e);
+            }
+            __m128i weight0 = _mm_add_epi16(same, keep);
+            __m128i weight1 = _mm_add_epi16(partner, set);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(next + chunk * 8), _mm_min_epi16(weight0, weight1));
+            __m128i cheaper = _mm_cmplt_epi16(weight1, weight0);
+            path[chunk] = static_cast<uint8_t>(_mm_movemask_epi8(_mm_packs_epi16(cheaper, cheaper)));
+        }
+#else
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            uint8_t bits = 0;
+            for (unsigned j = 0; j < 8; ++j) {
+                int weight0 = weights[chunk * 8 + j] + cost0;
+                int weight1 = weights[(chunk ^ high) * 8 + (j ^ low)] + cost1;
+                next[chunk * 8 + j] = static_cast<int16_t>(std::min(weight0, weight1));
+                bits |= (weight1 < weight0) << j;
+            }
+            path[chunk] = bits;
+        }
+#endif
+    }
+
+    unsigned h;
+    unsigned w;
+    std::vector<uint32_t> columns; // the submatrix, bit r of a column is row r
+};
+
+// Function to embed the next message bits into a band with the syndrome-trellis code; the band holds
+// whole segments but for the last. Returns the number of message bits embedded.
+size_t embedBandSTC(const SyndromeTrellisCode& code, char* data, size_t length, BitReader& bits, off_t offset, DirtyRanges& dirty) {
+    STATS_TIMER(Embed);
+    size_t start = bits.position();
+    size_t modifiedBefore = dirty.modifiedBytes;
+    embedUnitsInParallel(data, length, code.segmentBytes(), SyndromeTrellisCode::segmentBits, bits, offset, dirty,
+                         [&](char* part, size_t partLength, BitReader& partBits, off_t partOffset, DirtyRanges& partDirty) {
+                             std::vector<uint8_t> path;
+                             for (size_t segment = 0; segment < partLength; segment += code.segmentBytes()) {
+                                 size_t segmentLength = std::min(code.segmentBytes(), partLength - segment);
+                                 DirtyRanges segmentDirty;
+                                 code.embedSegment(part + segment, segmentLength, partBits, partOffset + segment, segmentDirty, path);
+                                 partDirty.append(segmentDirty, segment);
+                             }
+                         });
+    size_t embedded = std::min(length / code.width(), bits.size() - std::min(start, bits.size()));
+    STATS_ADD(BitsEmbedded, embedded);
+    STATS_ADD(CarrierBytesModified, dirty.modifiedBytes - modifiedBefore);
+    return embedded;
+}
+
+// Function to pass the bits carried by a band to bits with the syndrome-trellis code; the band holds whole
+// segments but for the last. Returns true as soon as the end of message marker was read.
+bool collectBandSTC(const SyndromeTrellisCode& code, const char* data, size_t length, BitWriter& bits) {
+    STATS_TIMER(Extract);
+    STATS_ADD(BitsExtracted, length / code.width());
+    return code.extract(data, length, bits);
+}
+
+// Function to get the code of --embedding stc<h>, nullptr for the other modes
+const SyndromeTrellisCode* selectedTrellisCode() {
+    const EmbeddingOptions& embedding = embeddingOptions();
+    return embedding.mode == "stc" ? &SyndromeTrellisCode::get(embedding.stcHeight, embedding.stcWidth) : nullptr;
+}
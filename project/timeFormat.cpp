@@ -0,0 +1,106 @@
+#include <limits>
+
+// Timestamps for --info without std::ctime, which looks up the time zone on every call, returns a shared
+// static buffer and is not thread-safe. The date is computed arithmetically and written into a buffer of
+// the caller; only the UTC offset of local time comes from localtime_r, and it is cached per thread for
+// each quarter hour it was asked for (offsets change at most on quarter hour boundaries since 1900).
+
+// Longest ISO-8601 timestamp: 2026-10-19T08:38:14.123456789+02:00
+const size_t isoTimestampSize = 35;
+// Longest epoch timestamp with nanoseconds: -9223372036854775808.123456789
+const size_t epochTimestampSize = 30;
+
+// Function to write value with at least width digits, zero padded; returns the end of the text
+inline char* writeDigits(char* out, uint64_t value, int width) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (count < width) {
+        digits[count++] = '0';
+    }
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+// Function to get the offset of local time from UTC at time, in seconds
+long localUTCOffset(time_t time) {
+    static const bool timeZoneLoaded = (tzset(), true); // localtime_r need not read TZ itself
+    (void)timeZoneLoaded;
+    struct CachedOffset {
+        time_t block = std::numeric_limits<time_t>::min();
+        long offset = 0;
+    };
+    thread_local std::array<CachedOffset, 64> cache;
+    time_t block = time >= 0 ? time / 900 : (time - 899) / 900;
+    CachedOffset& entry = cache[static_cast<uint64_t>(block) % cache.size()];
+    if (entry.block != block) {
+        struct tm local{};
+        entry.offset = localtime_r(&time, &local) ? local.tm_gmtoff : 0;
+        entry.block = block;
+    }
+    return entry.offset;
+}
+
+// Function to write time as local ISO-8601 with nanoseconds into out; returns the text
+std::string_view formatISO8601(const timespec& time, char (&out)[isoTimestampSize]) {
+    long offset = localUTCOffset(time.tv_sec);
+    int64_t seconds = static_cast<int64_t>(time.tv_sec) + offset;
+    int64_t days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+    int64_t secondOfDay = seconds - days * 86400;
+
+    // Civil date from days since 1970-01-01 (proleptic Gregorian calendar)
+    int64_t shifted = days + 719468;
+    int64_t era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+    int64_t dayOfEra = shifted - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t monthIndex = (5 * dayOfYear + 2) / 153; // months from March
+    int64_t day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    int64_t month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    int64_t year = yearOfEra + era * 400 + (month <= 2);
+
+    char* p = out;
+    year = std::clamp<int64_t>(year, 0, 9999);
+    p = writeDigits(p, year, 4);
+    *p++ = '-';
+    p = writeDigits(p, month, 2);
+    *p++ = '-';
+    p = writeDigits(p, day, 2);
+    *p++ = 'T';
+    p = writeDigits(p, secondOfDay / 3600, 2);
+    *p++ = ':';
+    p = writeDigits(p, secondOfDay / 60 % 60, 2);
+    *p++ = ':';
+    p = writeDigits(p, secondOfDay % 60, 2);
+    *p++ = '.';
+    p = writeDigits(p, time.tv_nsec, 9);
+    *p++ = offset < 0 ? '-' : '+';
+    long offsetMinutes = (offset < 0 ? -offset : offset) / 60;
+    p = writeDigits(p, offsetMinutes / 60, 2);
+    *p++ = ':';
+    p = writeDigits(p, offsetMinutes % 60, 2);
+    return {out, static_cast<size_t>(p - out)};
+}
+
+// Function to write time as seconds since the epoch with nanoseconds, e.g. 1792398925.123456789
+std::string_view formatEpoch(const timespec& time, char (&out)[epochTimestampSize]) {
+    char* p = out;
+    int64_t seconds = time.tv_sec;
+    long nanoseconds = time.tv_nsec;
+    if (seconds < 0 && nanoseconds > 0) { // -1.25 s is stored as tv_sec -2, tv_nsec 750000000
+        seconds += 1;
+        nanoseconds = 1000000000 - nanoseconds;
+    }
+    if (seconds < 0 || (seconds == 0 && time.tv_sec < 0)) {
+        *p++ = '-';
+    }
+    p = writeDigits(p, seconds < 0 ? 0 - static_cast<uint64_t>(seconds) : static_cast<uint64_t>(seconds), 1);
+    *p++ = '.';
+    p = writeDigits(p, nanoseconds, 9);
+    return {out, static_cast<size_t>(p - out)};
+}
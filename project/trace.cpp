@@ -0,0 +1,132 @@
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+// Trace of a run for --trace <file>, in the trace event format that chrome://tracing and Perfetto load.
+// Every phase timer (see stats.cpp) becomes a span on the thread that ran it, labelled with the file it
+// worked on; batch runs add the time each read and write spent in flight as asynchronous spans.
+// Spans go to a buffer of the recording thread and are written out as JSON at the end of the run.
+
+// One span, times in nanoseconds since the start of the trace
+struct TraceEvent {
+    const char* name;
+    int fileId;      // index into Tracer::files, -1 when the span belongs to no file
+    int64_t start;
+    int64_t duration;
+    int64_t asyncId; // >= 0 for an asynchronous span (I/O in flight)
+};
+
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Function to record a span of the calling thread
+    void record(const char* name, Clock::time_point start, Clock::time_point end, int64_t asyncId = -1) {
+        ThreadBuffer& buffer = local();
+        buffer.events.push_back({name, currentFile, nanosecondsSinceStart(start), nanosecondsSinceStart(end) - nanosecondsSinceStart(start), asyncId});
+    }
+
+    // Function to get the id of a file name for TraceEvent::fileId
+    int fileId(const std::string& filename) {
+        std::lock_guard lock(mutex);
+        files.push_back(filename);
+        return static_cast<int>(files.size() - 1);
+    }
+
+    // Function to write every recorded span to path as a JSON trace
+    void write(const std::string& path) {
+        std::lock_guard lock(mutex);
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Could not write the trace file " + path + ".");
+        }
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        auto separator = [&]() -> std::ostream& {
+            out << (first ? "" : ",\n");
+            first = false;
+            return out;
+        };
+        out << std::fixed << std::setprecision(3);
+        for (const auto& buffer : buffers) {
+            separator() << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId
+                        << ",\"args\":{\"name\":\"" << (buffer->threadId == 0 ? "main" : "worker " + std::to_string(buffer->threadId)) << "\"}}";
+            for (const TraceEvent& event : buffer->events) {
+                std::string args = event.fileId >= 0 ? ",\"args\":{\"file\":\"" + escape(files[event.fileId]) + "\"}" : "";
+                if (event.asyncId >= 0) {
+                    separator() << "{\"ph\":\"b\",\"cat\":\"io\",\"name\":\"" << event.name << "\",\"id\":" << event.asyncId
+                                << ",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << event.start / 1e3 << args << "}";
+                    separator() << "{\"ph\":\"e\",\"cat\":\"io\",\"name\":\"" << event.name << "\",\"id\":" << event.asyncId
+                                << ",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << (event.start + event.duration) / 1e3 << "}";
+                } else {
+                    separator() << "{\"ph\":\"X\",\"cat\":\"phase\",\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":"
+                                << buffer->threadId << ",\"ts\":" << event.start / 1e3 << ",\"dur\":" << event.duration / 1e3 << args << "}";
+                }
+            }
+        }
+        out << "\n]}\n";
+        if (!out) {
+            throw std::runtime_error("Could not write the trace file " + path + ".");
+        }
+    }
+
+    // The file the calling thread is working on, set with TraceFileScope
+    static inline thread_local int currentFile = -1;
+
+private:
+    struct ThreadBuffer {
+        int threadId;
+        std::vector<TraceEvent> events;
+    };
+
+    ThreadBuffer& local() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            std::lock_guard lock(mutex);
+            buffers.push_back(std::make_unique<ThreadBuffer>(ThreadBuffer{static_cast<int>(buffers.size()), {}}));
+            buffer = buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    int64_t nanosecondsSinceStart(Clock::time_point time) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - startTime).count();
+    }
+
+    // Function to escape a file name for a JSON string
+    static std::string escape(const std::string& text) {
+        std::string escaped;
+        for (unsigned char character : text) {
+            if (character == '"' || character == '\\') {
+                escaped += '\\';
+                escaped += static_cast<char>(character);
+            } else if (character < 0x20) {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", character);
+                escaped += code;
+            } else {
+                escaped += static_cast<char>(character);
+            }
+        }
+        return escaped;
+    }
+
+    Clock::time_point startTime = Clock::now();
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers; // every thread that recorded a span
+    std::vector<std::string> files;
+};
+
+Tracer tracer;
+
+// Labels the spans of the calling thread with a file while it is in scope
+class TraceFileScope {
+public:
+    explicit TraceFileScope(int fileId) : previous(Tracer::currentFile) { Tracer::currentFile = fileId; }
+    ~TraceFileScope() { Tracer::currentFile = previous; }
+    TraceFileScope(const TraceFileScope&) = delete;
+    TraceFileScope& operator=(const TraceFileScope&) = delete;
+
+private:
+    int previous;
+};
@@ -0,0 +1,99 @@
+// --update: replaces the message of an image by a new revision of it, e.g. a manifest of which only a few
+// kilobytes change. Every message byte has a fixed place in the carrier (byte i lives in the LSBs of
+// carrier bytes 8i..8i+7), so the carrier region of an unchanged part of the message already holds the
+// right bits. The bits the image holds are read once and compared with the new message, followed by its
+// end of message marker, in blocks of updateBlockBytes message bytes; only the carrier regions of the
+// blocks that differ are embedded again and written back. The marker moves with the length of the message
+// and its block is rewritten whenever the length changes.
+
+const size_t updateBlockBytes = DirtyRanges::blockSize / 8; // message bytes per block of carrier bytes
+
+// Function to get the bits the carrier holds at the place of the first length message bytes, as bytes
+std::string readCarrierBytes(int fd, uint32_t dataOffset, size_t length, size_t bandSize) {
+    std::string carried(length, '\0');
+    PooledBuffer band = BufferPool::local().acquire(bandSize);
+    size_t carrierBytes = length * 8;
+    for (size_t bandStart = 0; bandStart < carrierBytes; bandStart += bandSize) {
+        size_t bandLength = std::min(bandSize, carrierBytes - bandStart);
+        readAt(fd, band.data(), bandLength, dataOffset + bandStart);
+        size_t bytes = packBandBits(band.data(), bandLength);
+        std::memcpy(carried.data() + bandStart / 8, band.data(), bytes);
+    }
+    return carried;
+}
+
+// Function to update the message of a BMP image to message; returns the number of carrier bytes that changed
+size_t updateMessageInBMP(const std::string& filename, const std::string& message) {
+    TRACE_FILE(filename);
+    if (codedEmbedding()) { // lsb and matching keep every message bit in its own carrier byte
+        requireLSBEmbedding("with --update");
+    }
+    FileDescriptor fd(openFile(filename, O_RDWR));
+    if (fd.fd < 0) {
+        throw std::runtime_error("Could not open BMP file for writing.");
+    }
+    char header[bmpHeaderSize];
+    readAt(fd.fd, header, bmpHeaderSize, 0);
+    uint32_t width, height;
+    uint16_t bitsPerPixel;
+    uint32_t dataOffset;
+    size_t pixelBytes;
+    {
+        STATS_TIMER(HeaderParse);
+        dataOffset = parseBMPHeader(header, width, height, bitsPerPixel);
+        struct stat fileInfo{};
+        STATS_ADD(Syscalls, 1);
+        if (fstat(fd.fd, &fileInfo) != 0 || fileInfo.st_size <= dataOffset) {
+            throw std::runtime_error("Could not get file size.");
+        }
+        pixelBytes = fileInfo.st_size - dataOffset;
+    }
+    if (payloadLength(message.length()) > pixelBytes / (bitsPerPixel / 8) / 8) {
+        throw std::runtime_error("Message is too long to fit in the image.");
+    }
+
+    // The new message with its end of message marker, as it has to end up in the carrier
+    std::string wanted = messagePayload(message) + std::string(BitReader::markerBits / 8, '\0');
+    wanted.resize(std::min(wanted.size(), pixelBytes / 8)); // the marker may not fit completely, as when embedding
+    size_t bandSize = std::max(DirtyRanges::blockSize, bmpBandSize(width, bitsPerPixel) / DirtyRanges::blockSize * DirtyRanges::blockSize);
+    std::string carried = readCarrierBytes(fd.fd, dataOffset, wanted.size(), bandSize);
+
+    // Embed the runs of blocks that differ
+    BitReader bits(message);
+    PooledBuffer band = BufferPool::local().acquire(bandSize);
+    size_t blocks = (wanted.size() + updateBlockBytes - 1) / updateBlockBytes;
+    size_t changedBlocks = 0;
+    size_t modified = 0;
+    auto differs = [&](size_t block) {
+        size_t start = block * updateBlockBytes;
+        size_t length = std::min(updateBlockBytes, wanted.size() - start);
+        return std::memcmp(wanted.data() + start, carried.data() + start, length) != 0;
+    };
+    for (size_t block = 0; block < blocks;) {
+        if (!differs(block)) {
+            ++block;
+            continue;
+        }
+        size_t last = block + 1;
+        while (last < blocks && differs(last) && (last + 1 - block) * DirtyRanges::blockSize <= bandSize) {
+            ++last;
+        }
+        size_t start = block * DirtyRanges::blockSize;
+        size_t length = std::min(last * updateBlockBytes, wanted.size()) * 8 - start;
+        readAt(fd.fd, band.data(), length, dataOffset + start);
+        bits.seek(start);
+        DirtyRanges dirty;
+        embedBandBits(band.data(), length, bits, dataOffset + start, dirty);
+        writeDirtyRanges(fd.fd, band.data(), dirty, dataOffset + start);
+        modified += dirty.modifiedBytes;
+        changedBlocks += last - block;
+        block = last;
+    }
+    if (modified > 0) {
+        syncFile(fd.fd);
+    }
+
+    std::cout << "Message updated in BMP file, " << changedBlocks << " of " << blocks << " blocks embedded again, "
+              << modified << " bytes modified" << std::endl;
+    return modified;
+}